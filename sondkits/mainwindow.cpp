@@ -240,6 +240,10 @@ void MainWindow::onOpenFile() {
   try{
     m_player->open(fileName.toStdWString());
     m_playPauseButton->setEnabled(true);
+    m_totalDuration = m_player->duration() / 1000.0;
+    m_progressSlider->setEnabled(m_totalDuration > 0);
+    m_progressSlider->setValue(0);
+    m_totalTimeLabel->setText(formatTime(m_totalDuration));
     auto info = m_player->fetchAudioInfo();
      m_audioInfoLabel->setText(QString("BPM: %1, Key: %2, 通道: %3, 采样率: %4, 采样格式: %5,\r\n 时长: %6, 耗时: %7ms")
                            .arg(info.bpm)
@@ -251,6 +255,7 @@ void MainWindow::onOpenFile() {
                            .arg(info.consume_time_ms));
   }catch(const std::exception& e){
     m_playPauseButton->setEnabled(false);
+    m_progressSlider->setEnabled(false);
     m_audioInfoLabel->setText("错误: " + QString(e.what()));
   }
 }
@@ -336,6 +341,10 @@ void MainWindow::onProgressSliderReleased() {
 
   // 定位到新位置
   if (m_player && m_totalDuration > 0) {
+    double position =
+        (double)m_progressSlider->value() / 1000.0 * m_totalDuration;
+    auto seeked_ms = m_player->seek((int64_t)(position * 1000));
+    m_currentTimeLabel->setText(formatTime(seeked_ms / 1000.0));
   }
 }
 
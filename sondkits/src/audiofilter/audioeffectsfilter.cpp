@@ -3,7 +3,10 @@ extern "C" {
 #include <libavutil/avutil.h>
 }
 #include "SoundTouch.h"
+#include "gainkernels.h"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 
 AudioEffectsFilter::AudioEffectsFilter(AudioEffectsFilterConfig config)
@@ -13,11 +16,20 @@ AudioEffectsFilter::AudioEffectsFilter(AudioEffectsFilterConfig config)
   m_volume.store(1.0f);
   for (int i = 0; i < m_config.channels; i++) {
     m_channels_volumes[i].store(1.0f);
+    m_applied_gains[i] = 1.0f;
   }
 
+  m_target_tempo.store(1.0f);
+  m_target_semitone.store(0.0f);
   m_tempo = 1.0f;
-  m_semitone = 0;
-  newSoundTouch();
+  m_semitone = 0.0f;
+  m_soundtouch_active = false;
+  m_soundtouch_flushed = false;
+  m_soundtouch = std::make_unique<soundtouch::SoundTouch>();
+  m_soundtouch->setSampleRate(m_config.sample_rate);
+  m_soundtouch->setChannels(m_config.channels);
+  m_soundtouch->setTempo(m_tempo);
+  m_soundtouch->setPitchSemiTones(m_semitone);
 }
 
 AudioEffectsFilter::~AudioEffectsFilter() {}
@@ -46,13 +58,11 @@ void AudioEffectsFilter::setTempo(float tempo) {
     return;
   if (tempo > m_config.max_tempo)
     tempo = m_config.max_tempo;
-  m_tempo = tempo;
-  newSoundTouch();
+  m_target_tempo.store(tempo);
 }
 
 void AudioEffectsFilter::setSemitone(int semitone) {
-  m_semitone = semitone;
-  newSoundTouch();
+  m_target_semitone.store((float)semitone);
 }
 
 void AudioEffectsFilter::setVolumeBalance(float balance) {
@@ -100,64 +110,86 @@ void AudioEffectsFilter::reciveRemaining(uint8_t *data, int64_t *size) {
   m_sound_touch_lock.unlock();
 }
 
+void AudioEffectsFilter::reset() {
+  m_sound_touch_lock.lock();
+  if (m_soundtouch) {
+    m_soundtouch->clear();
+    m_soundtouch_flushed = false;
+  }
+  // 缓存已清空，已经回到原速时可以重新绕过 SoundTouch
+  m_soundtouch_active = m_tempo != 1.0f || m_semitone != 0.0f;
+  m_sound_touch_lock.unlock();
+}
+
+// 不变速变调时 SoundTouch 不参与处理，没有延迟
+int64_t AudioEffectsFilter::latencyFrames() const {
+  int64_t frames = 0;
+  m_sound_touch_lock.lock();
+  if (m_soundtouch && m_soundtouch_active) {
+    frames = m_soundtouch->numUnprocessedSamples() +
+             m_soundtouch->numSamples();
+  }
+  m_sound_touch_lock.unlock();
+  return frames;
+}
+
+// 较大的跳变分摊到 glide_ms 内的多个块上，每块按块长所占比例逼近目标值，
+// 接近目标后直接取目标值；setTempo/setPitchSemiTones 只重新计算内部参数
+bool AudioEffectsFilter::update_soundtouch(int64_t frames) {
+  if (!m_soundtouch) {
+    return false;
+  }
+  const float tempo = m_target_tempo.load();
+  const float semitone = m_target_semitone.load();
+  if (tempo != m_tempo || semitone != m_semitone) {
+    float fraction = 1.0f;
+    // 从绕过状态开始时 SoundTouch 是空的，直接使用目标值
+    if (m_config.glide_ms > 0 && m_soundtouch_active) {
+      fraction = std::min(1.0f, frames * 1000.0f / (m_config.sample_rate *
+                                                    m_config.glide_ms));
+    }
+    m_tempo += (tempo - m_tempo) * fraction;
+    m_semitone += (semitone - m_semitone) * fraction;
+    if (std::fabs(tempo - m_tempo) < 0.005f) {
+      m_tempo = tempo;
+    }
+    if (std::fabs(semitone - m_semitone) < 0.05f) {
+      m_semitone = semitone;
+    }
+    m_soundtouch->setTempo(m_tempo);
+    m_soundtouch->setPitchSemiTones((double)m_semitone);
+  }
+  if (m_tempo != 1.0f || m_semitone != 0.0f) {
+    m_soundtouch_active = true;
+  }
+  return m_soundtouch_active;
+}
+
+bool AudioEffectsFilter::updateGains(float *start, float *end) {
+  const float volume = m_volume.load();
+  bool unity = true;
+  for (int c = 0; c < m_config.channels; c++) {
+    start[c] = m_applied_gains[c];
+    end[c] = m_channels_volumes[c].load() * volume;
+    m_applied_gains[c] = end[c];
+    unity = unity && start[c] == 1.0f && end[c] == 1.0f;
+  }
+  return !unity;
+}
+
+// 每块只读一次音量，块内按声道从上一块的增益线性过渡到当前音量
 FilterProcessResult AudioEffectsFilter::applyVolume(uint8_t *data,
                                                     int64_t *size) {
   if (!data || !size || *size <= 0) {
     return AUDIO_PROCESS_RESULT_SUCCESS;
   }
-  const int samples = *size / m_sample_size; // 交错采样，逐样本缩放即可
-  switch (m_config.format) {
-  case AV_SAMPLE_FMT_U8: {
-    forEachChannelSample<uint8_t>(
-        data, *size, [this](uint8_t *data, int channel_num) {
-          applyU8SampleVolume(data, m_channels_volumes[channel_num].load() *
-                                        m_volume.load());
-        });
-    break;
-  }
-  case AV_SAMPLE_FMT_S16: {
-    forEachChannelSample<int16_t>(
-        data, *size, [this](int16_t *data, int channel_num) {
-          applySignedSampleVolume<int16_t, float>(
-              data, m_channels_volumes[channel_num].load() * m_volume.load());
-        });
-    break;
-  }
-  case AV_SAMPLE_FMT_S32: {
-    forEachChannelSample<int32_t>(
-        data, *size, [this](int32_t *data, int channel_num) {
-          applySignedSampleVolume<int32_t, double>(
-              data, m_channels_volumes[channel_num].load() * m_volume.load());
-        });
-    break;
-  }
-  case AV_SAMPLE_FMT_S64: {
-    forEachChannelSample<int64_t>(
-        data, *size, [this](int64_t *data, int channel_num) {
-          applySignedSampleVolume<int64_t, long double>(
-              data, m_channels_volumes[channel_num].load() * m_volume.load());
-        });
-    break;
-  }
-  case AV_SAMPLE_FMT_FLT: {
-    forEachChannelSample<float>(
-        data, *size, [this](float *data, int channel_num) {
-          applySignedSampleVolume<float, float>(
-              data, m_channels_volumes[channel_num].load() * m_volume.load());
-        });
-    break;
-  }
-  case AV_SAMPLE_FMT_DBL: {
-    forEachChannelSample<double>(
-        data, *size, [this](double *data, int channel_num) {
-          applySignedSampleVolume<double, double>(
-              data, m_channels_volumes[channel_num].load() * m_volume.load());
-        });
-    break;
-  }
-  default:
-    break;
+  float start[10];
+  float end[10];
+  if (!updateGains(start, end)) {
+    return AUDIO_PROCESS_RESULT_SUCCESS;
   }
+  const int64_t frames = *size / (m_sample_size * m_config.channels);
+  applyGainRamp(m_config.format, data, frames, m_config.channels, start, end);
   return AUDIO_PROCESS_RESULT_SUCCESS;
 }
 
@@ -169,11 +201,10 @@ FilterProcessResult AudioEffectsFilter::applyTempoAndSemitone(uint8_t *data,
   if (m_config.format != AV_SAMPLE_FMT_FLT) {
     return AUDIO_PROCESS_RESULT_ERROR;
   }
+  auto num_samples = *size / sizeof(soundtouch::SAMPLETYPE) / m_config.channels;
   m_sound_touch_lock.lock();
   FilterProcessResult result = AUDIO_PROCESS_RESULT_SUCCESS;
-  if (m_soundtouch && (m_tempo != 1.0f || m_semitone != 0)) {
-    auto num_samples =
-        *size / sizeof(soundtouch::SAMPLETYPE) / m_config.channels;
+  if (update_soundtouch(num_samples)) {
     m_soundtouch->putSamples(reinterpret_cast<soundtouch::SAMPLETYPE *>(data),
                              num_samples);
     auto num = m_soundtouch->receiveSamples(
@@ -186,33 +217,3 @@ FilterProcessResult AudioEffectsFilter::applyTempoAndSemitone(uint8_t *data,
   m_sound_touch_lock.unlock();
   return result;
 }
-
-void AudioEffectsFilter::applyU8SampleVolume(uint8_t *data, float volume) {
-  int v = static_cast<int>(*data) - 128; // 转为有符号中心 0
-  float scaled = v * volume;
-  if (scaled > 127.0f)
-    scaled = 127.0f;
-  else if (scaled < -128.0f)
-    scaled = -128.0f;
-  int out = static_cast<int>(scaled) + 128;
-  if (out < 0) {
-    out = 0;
-  } else if (out > 255) {
-    out = 255;
-  }
-  *data = static_cast<uint8_t>(out);
-}
-
-void AudioEffectsFilter::newSoundTouch() {
-  m_sound_touch_lock.lock();
-  if (m_soundtouch) {
-    m_soundtouch->clear();
-    m_soundtouch_flushed = false;
-  }
-  m_soundtouch = std::make_unique<soundtouch::SoundTouch>();
-  m_soundtouch->setSampleRate(m_config.sample_rate);
-  m_soundtouch->setChannels(m_config.channels);
-  m_soundtouch->setTempo(m_tempo);
-  m_soundtouch->setPitchSemiTones(m_semitone);
-  m_sound_touch_lock.unlock();
-}
@@ -3,8 +3,6 @@
 #include "audiofilter.h"
 #include "common.h"
 #include <atomic>
-#include <functional>
-#include <limits>
 #include <memory>
 extern "C" {
 #include <libavformat/avformat.h>
@@ -18,6 +16,8 @@ struct AudioEffectsFilterConfig {
   AVSampleFormat format;
   float max_tempo;
   float min_tempo;
+  // 变速变调参数从当前值过渡到目标值的时间，0 表示立即生效
+  float glide_ms = 30.0f;
 };
 
 namespace soundtouch {
@@ -33,6 +33,8 @@ public:
   float volume(int channel_num = -1);
   //[-1.0, 1.0]
   void setVolumeBalance(float balance);
+  // 只记录目标值，音频线程在下一块开始时原地更新 SoundTouch 的参数，
+  // 不重建实例也不清空其中缓存的数据
   void setTempo(float tempo);
   //[-12, 12]
   void setSemitone(int semitone);
@@ -41,42 +43,37 @@ public:
 
   int64_t flushRemaining() override;
   void reciveRemaining(uint8_t *data, int64_t *size) override;
+  void reset() override;
+  int64_t latencyFrames() const override;
 
 private:
   FilterProcessResult applyVolume(uint8_t *data, int64_t *size);
   FilterProcessResult applyTempoAndSemitone(uint8_t *data, int64_t *size);
-  void newSoundTouch();
+  // 以下在持有 m_sound_touch_lock 时调用
+  // 把参数向目标值推进一块的长度，返回这一块是否需要经过 SoundTouch
+  bool update_soundtouch(int64_t frames);
 
-  template <typename T>
-  void forEachChannelSample(uint8_t *data, int64_t size,
-                            std::function<void(T *, int)> &&func) {
-    const int samples = size / m_sample_size;
-    T *pcm = reinterpret_cast<T *>(data);
-    for (int i = 0; i < samples; ++i) {
-      func(pcm + i, i % m_config.channels);
-    }
-  }
-
-  void applyU8SampleVolume(uint8_t *data, float volume);
-  template <typename T, typename S>
-  void applySignedSampleVolume(T *data, float volume) {
-    S scaled = (S)((S)(*data) * volume);
-    if (scaled > std::numeric_limits<T>::max())
-      scaled = std::numeric_limits<T>::max();
-    else if (scaled < std::numeric_limits<T>::lowest())
-      scaled = std::numeric_limits<T>::lowest();
-    *data = static_cast<T>(scaled);
-  }
+  // 读取一次各声道的目标增益，返回是否需要处理(全部为 1 且没有过渡时跳过)
+  bool updateGains(float *start, float *end);
 
 private:
   AudioEffectsFilterConfig m_config;
   int m_sample_size;
   std::atomic<float> m_volume;
   std::atomic<float> m_channels_volumes[10];
+  // 上一块结束时实际使用的增益，只在音频线程访问；
+  // 音量变化时下一块从这里线性过渡到新值
+  float m_applied_gains[10];
 
-  SpinLock m_sound_touch_lock;
+  mutable SpinLock m_sound_touch_lock;
   std::unique_ptr<soundtouch::SoundTouch> m_soundtouch;
   bool m_soundtouch_flushed;
+  std::atomic<float> m_target_tempo;
+  std::atomic<float> m_target_semitone;
+  // 当前实际使用的参数，过渡期间为中间值
   float m_tempo;
-  int m_semitone;
+  float m_semitone;
+  // 参数回到 1 倍速、不变调后仍经过 SoundTouch，直到 reset，
+  // 避免绕过时丢弃其中缓存的数据
+  bool m_soundtouch_active;
 };
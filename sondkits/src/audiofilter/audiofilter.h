@@ -14,4 +14,8 @@ public:
   virtual FilterProcessResult process(uint8_t *data, int64_t *size) = 0;
   virtual int64_t flushRemaining() = 0;
   virtual void reciveRemaining(uint8_t *data, int64_t *size) = 0;
+  // 数据不连续(如 seek)时丢弃内部缓存的采样
+  virtual void reset() = 0;
+  // 当前缓存在滤镜内部、尚未输出的帧数，即该滤镜引入的延迟
+  virtual int64_t latencyFrames() const { return 0; }
 };
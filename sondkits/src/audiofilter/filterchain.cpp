@@ -0,0 +1,197 @@
+#include "filterchain.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+static int64_t steadyNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+FilterChain::FilterChain(FilterChainConfig config)
+    : m_config(config),
+      m_frame_size(config.channels * av_get_bytes_per_sample(config.format)),
+      m_flush_stage(0), m_flush_pos(0), m_flush_size(0) {
+  m_stages.reserve(std::max(config.max_stages, 1));
+  m_flush_buffer.resize(std::max<int64_t>(config.max_frames, 1) *
+                        m_frame_size);
+}
+
+bool FilterChain::addStage(const std::string &name,
+                           std::shared_ptr<AudioFilter> filter) {
+  if (!filter) {
+    return false;
+  }
+  auto stage = std::make_shared<Stage>();
+  stage->name = name;
+  stage->filter = filter;
+  std::lock_guard<SpinLock> lock(m_lock);
+  if (m_stages.size() >= m_stages.capacity()) {
+    return false;
+  }
+  for (auto &s : m_stages) {
+    if (s->name == name) {
+      return false;
+    }
+  }
+  m_stages.push_back(std::move(stage));
+  return true;
+}
+
+bool FilterChain::removeStage(const std::string &name) {
+  // 在锁外释放，析构可能较慢
+  std::shared_ptr<Stage> removed;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    auto it = std::find_if(m_stages.begin(), m_stages.end(),
+                           [&](const std::shared_ptr<Stage> &stage) {
+                             return stage->name == name;
+                           });
+    if (it == m_stages.end()) {
+      return false;
+    }
+    removed = std::move(*it);
+    m_stages.erase(it);
+    m_flush_stage = std::min(m_flush_stage, m_stages.size());
+  }
+  return true;
+}
+
+std::shared_ptr<AudioFilter>
+FilterChain::stage(const std::string &name) const {
+  std::lock_guard<SpinLock> lock(m_lock);
+  for (auto &stage : m_stages) {
+    if (stage->name == name) {
+      return stage->filter;
+    }
+  }
+  return nullptr;
+}
+
+// 只在锁内取出各级的引用，名字的拷贝等分配放在锁外
+std::vector<FilterStageStats> FilterChain::stats() const {
+  std::vector<std::shared_ptr<const Stage>> stages;
+  stages.reserve(m_stages.capacity());
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    for (auto &stage : m_stages) {
+      stages.push_back(stage);
+    }
+  }
+  std::vector<FilterStageStats> result;
+  for (auto &stage : stages) {
+    FilterStageStats stats;
+    stats.name = stage->name;
+    stats.latency_frames = stage->filter->latencyFrames();
+    stats.latency_ms =
+        m_config.sample_rate > 0
+            ? stats.latency_frames * 1000.0 / m_config.sample_rate
+            : 0;
+    stats.processed_frames = stage->frames.load();
+    auto samples = stats.processed_frames * m_config.channels;
+    stats.cpu_ns_per_sample =
+        samples > 0 ? (double)stage->cpu_ns.load() / samples : 0;
+    result.push_back(stats);
+  }
+  return result;
+}
+
+int64_t FilterChain::latencyFrames() const {
+  int64_t frames = 0;
+  std::lock_guard<SpinLock> lock(m_lock);
+  for (auto &stage : m_stages) {
+    frames += stage->filter->latencyFrames();
+  }
+  return frames;
+}
+
+FilterProcessResult FilterChain::process(uint8_t *data, int64_t *size) {
+  if (!data || !size || *size <= 0) {
+    return AUDIO_PROCESS_RESULT_SUCCESS;
+  }
+  std::lock_guard<SpinLock> lock(m_lock);
+  // 有新数据时上一次冲刷已经失效
+  m_flush_stage = 0;
+  m_flush_pos = 0;
+  m_flush_size = 0;
+  return run_stages(0, data, size);
+}
+
+FilterProcessResult FilterChain::run_stages(size_t first, uint8_t *data,
+                                            int64_t *size) {
+  for (auto i = first; i < m_stages.size(); i++) {
+    auto &stage = *m_stages[i];
+    auto frames = *size / m_frame_size;
+    auto start = steadyNowNs();
+    auto r = stage.filter->process(data, size);
+    add_cost(stage, start, frames);
+    if (r != AUDIO_PROCESS_RESULT_SUCCESS) {
+      return r;
+    }
+    if (*size <= 0) {
+      return AUDIO_PROCESS_RESULT_AGAIN;
+    }
+  }
+  return AUDIO_PROCESS_RESULT_SUCCESS;
+}
+
+void FilterChain::add_cost(Stage &stage, int64_t start_ns, int64_t frames) {
+  stage.cpu_ns.fetch_add(steadyNowNs() - start_ns, std::memory_order_relaxed);
+  stage.frames.fetch_add(frames, std::memory_order_relaxed);
+}
+
+// 每次取出一级的一块剩余数据，经过后面的级后放在中转缓冲里等待读取；
+// 某级的剩余数据全部取完后再冲刷下一级
+int64_t FilterChain::flushRemaining() {
+  std::lock_guard<SpinLock> lock(m_lock);
+  if (m_flush_pos < m_flush_size) {
+    return m_flush_size - m_flush_pos;
+  }
+  m_flush_pos = 0;
+  m_flush_size = 0;
+  auto capacity = (int64_t)m_flush_buffer.size();
+  while (capacity > 0 && m_flush_stage < m_stages.size()) {
+    auto &stage = *m_stages[m_flush_stage];
+    auto size = std::min(stage.filter->flushRemaining(), capacity);
+    size = size / m_frame_size * m_frame_size;
+    if (size > 0) {
+      stage.filter->reciveRemaining(m_flush_buffer.data(), &size);
+    }
+    if (size <= 0) {
+      m_flush_stage++;
+      continue;
+    }
+    auto r = run_stages(m_flush_stage + 1, m_flush_buffer.data(), &size);
+    if (r == AUDIO_PROCESS_RESULT_ERROR) {
+      m_flush_stage = m_stages.size();
+      break;
+    }
+    if (r == AUDIO_PROCESS_RESULT_SUCCESS && size > 0) {
+      m_flush_size = size;
+      break;
+    }
+  }
+  return m_flush_size;
+}
+
+void FilterChain::reciveRemaining(uint8_t *data, int64_t *size) {
+  std::lock_guard<SpinLock> lock(m_lock);
+  auto len = std::min(*size, m_flush_size - m_flush_pos);
+  if (len > 0) {
+    memcpy(data, m_flush_buffer.data() + m_flush_pos, len);
+    m_flush_pos += len;
+  }
+  *size = std::max<int64_t>(len, 0);
+}
+
+void FilterChain::reset() {
+  std::lock_guard<SpinLock> lock(m_lock);
+  for (auto &stage : m_stages) {
+    stage->filter->reset();
+  }
+  m_flush_stage = 0;
+  m_flush_pos = 0;
+  m_flush_size = 0;
+}
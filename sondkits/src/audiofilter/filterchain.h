@@ -0,0 +1,82 @@
+#pragma once
+
+#include "audiofilter.h"
+#include "common.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+struct FilterChainConfig {
+  int sample_rate;
+  int channels;
+  AVSampleFormat format;
+  // 单次 process 最多的帧数，决定结尾冲刷时中转缓冲的大小
+  int64_t max_frames = 8192;
+  // 最多的级数，级数组一次分配好，增删级时不再分配
+  int max_stages = 16;
+};
+
+struct FilterStageStats {
+  std::string name;
+  // 当前缓存在该级内部的延迟
+  int64_t latency_frames;
+  double latency_ms;
+  // 平均每个采样(每声道)的处理耗时
+  double cpu_ns_per_sample;
+  int64_t processed_frames;
+};
+
+// 按顺序串联多个滤镜，每级都是一个 AudioFilter，原地处理同一块数据；
+// 新增均衡器、限幅器等效果只需实现 AudioFilter 并 addStage
+// 某一级暂时没有输出(AGAIN)时后面的级不再执行；数据结束时从第一级开始
+// 依次冲刷，每级的剩余数据经过后面所有级后再输出
+// 音频线程上不分配内存：级数组和冲刷用的中转缓冲在构造时分配
+class FilterChain : public AudioFilter {
+public:
+  explicit FilterChain(FilterChainConfig config);
+
+  // 在控制线程调用，超过 max_stages 时返回 false
+  bool addStage(const std::string &name, std::shared_ptr<AudioFilter> filter);
+  bool removeStage(const std::string &name);
+  std::shared_ptr<AudioFilter> stage(const std::string &name) const;
+  // 各级的延迟和耗时，在控制线程调用
+  std::vector<FilterStageStats> stats() const;
+  // 所有级的延迟之和
+  int64_t latencyFrames() const override;
+
+  FilterProcessResult process(uint8_t *data, int64_t *size) override;
+  int64_t flushRemaining() override;
+  void reciveRemaining(uint8_t *data, int64_t *size) override;
+  void reset() override;
+
+private:
+  struct Stage {
+    std::string name;
+    std::shared_ptr<AudioFilter> filter;
+    std::atomic<int64_t> cpu_ns{0};
+    std::atomic<int64_t> frames{0};
+  };
+
+  // 以下在持有 m_lock 时调用
+  FilterProcessResult run_stages(size_t first, uint8_t *data, int64_t *size);
+  void add_cost(Stage &stage, int64_t start_ns, int64_t frames);
+
+private:
+  const FilterChainConfig m_config;
+  const int64_t m_frame_size;
+
+  // 音频线程处理期间持有，增删级只交换指针；
+  // stats 在锁外读取时持有引用，不会被并发的 removeStage 释放
+  mutable SpinLock m_lock;
+  std::vector<std::shared_ptr<Stage>> m_stages;
+
+  // flush
+  std::vector<uint8_t> m_flush_buffer;
+  size_t m_flush_stage;
+  int64_t m_flush_pos;
+  int64_t m_flush_size;
+};
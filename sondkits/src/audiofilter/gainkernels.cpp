@@ -0,0 +1,508 @@
+#include "gainkernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define GAIN_USE_SSE 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GAIN_TARGET_AVX2
+#else
+#define GAIN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GAIN_USE_NEON 1
+#endif
+
+// 向量核每次处理 8 个采样；交错数据中声道的排列按 lcm(8, 声道数) 个采样
+// 重复，预先展开一个周期的起始增益和每周期的增量，之后按周期整体推进
+static constexpr int kLanes = 8;
+static constexpr int kMaxChannels = 16;
+static constexpr int kMaxPeriod = kLanes * kMaxChannels;
+
+static inline uint8_t scaleSample(uint8_t v, float gain) {
+  float scaled = (static_cast<int>(v) - 128) * gain;
+  scaled = std::clamp(scaled, -128.0f, 127.0f);
+  return static_cast<uint8_t>(static_cast<int>(scaled) + 128);
+}
+
+// 与向量核的 cvtps 一致，按最近值取整
+static inline int16_t scaleSample(int16_t v, float gain) {
+  float scaled = std::clamp(v * gain, -32768.0f, 32767.0f);
+  return static_cast<int16_t>(std::lrint(scaled));
+}
+
+// 以 double 计算，与向量核的 cvtpd 一致按最近值取整
+static constexpr double kS32Min = std::numeric_limits<int32_t>::lowest();
+static constexpr double kS32Max = std::numeric_limits<int32_t>::max();
+
+static inline int32_t scaleSample(int32_t v, float gain) {
+  double scaled = std::clamp((double)v * gain, kS32Min, kS32Max);
+  return static_cast<int32_t>(std::lrint(scaled));
+}
+
+static inline int64_t scaleSample(int64_t v, float gain) {
+  long double scaled =
+      std::clamp((long double)v * gain,
+                 (long double)std::numeric_limits<int64_t>::lowest(),
+                 (long double)std::numeric_limits<int64_t>::max());
+  return static_cast<int64_t>(scaled);
+}
+
+static inline float scaleSample(float v, float gain) { return v * gain; }
+
+static inline double scaleSample(double v, float gain) { return v * gain; }
+
+// 以下核函数处理 periods 个完整周期，第 p 个周期的增益为 base + inc * p，
+// 每个周期重新计算而不是累加，长块上不会积累误差
+template <typename T>
+static void gainPeriodsScalar(T *data, int64_t periods, const float *base,
+                              const float *inc, int period) {
+  for (int64_t p = 0; p < periods; p++, data += period) {
+    for (int s = 0; s < period; s++) {
+      data[s] = scaleSample(data[s], base[s] + inc[s] * p);
+    }
+  }
+}
+
+#if !GAIN_USE_SSE && !GAIN_USE_NEON
+// 混音累加版本：dst += src * gain
+static void mixPeriodsScalar(float *dst, const float *src, int64_t periods,
+                             const float *base, const float *inc, int period) {
+  for (int64_t p = 0; p < periods; p++, dst += period, src += period) {
+    for (int s = 0; s < period; s++) {
+      dst[s] += src[s] * (base[s] + inc[s] * p);
+    }
+  }
+}
+#endif
+
+#if GAIN_USE_SSE
+static inline void fltx8SSE(float *p, __m128 g0, __m128 g1) {
+  _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), g0));
+  _mm_storeu_ps(p + 4, _mm_mul_ps(_mm_loadu_ps(p + 4), g1));
+}
+
+static inline void s16x8SSE(int16_t *p, __m128 g0, __m128 g1) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  // 高位复制后算术右移完成符号扩展
+  __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+  __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+  __m128i r = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(lo, g0)),
+                              _mm_cvtps_epi32(_mm_mul_ps(hi, g1)));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), r);
+}
+
+// S32 转成 double 计算，float 的 24 位尾数不够
+static inline __m128i s32x2SSE(__m128i x, __m128 g) {
+  __m128d v = _mm_mul_pd(_mm_cvtepi32_pd(x), _mm_cvtps_pd(g));
+  v = _mm_min_pd(_mm_max_pd(v, _mm_set1_pd(kS32Min)), _mm_set1_pd(kS32Max));
+  return _mm_cvtpd_epi32(v);
+}
+
+static inline void s32x4SSE(int32_t *p, __m128 g) {
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  __m128i lo = s32x2SSE(x, g);
+  __m128i hi = s32x2SSE(_mm_unpackhi_epi64(x, x), _mm_movehl_ps(g, g));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_unpacklo_epi64(lo, hi));
+}
+
+static inline void s32x8SSE(int32_t *p, __m128 g0, __m128 g1) {
+  s32x4SSE(p, g0);
+  s32x4SSE(p + 4, g1);
+}
+
+static inline void dblx4SSE(double *p, __m128 g) {
+  _mm_storeu_pd(p, _mm_mul_pd(_mm_loadu_pd(p), _mm_cvtps_pd(g)));
+  _mm_storeu_pd(p + 2, _mm_mul_pd(_mm_loadu_pd(p + 2),
+                                  _mm_cvtps_pd(_mm_movehl_ps(g, g))));
+}
+
+static inline void dblx8SSE(double *p, __m128 g0, __m128 g1) {
+  dblx4SSE(p, g0);
+  dblx4SSE(p + 4, g1);
+}
+
+// 立体声、单声道等周期正好为 8 的情况增益常驻寄存器
+template <typename T, void (*Op)(T *, __m128, __m128)>
+static void gainPeriodsSSE(T *data, int64_t periods, const float *base,
+                           const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const __m128 b0 = _mm_loadu_ps(base + s);
+    const __m128 b1 = _mm_loadu_ps(base + s + 4);
+    const __m128 i0 = _mm_loadu_ps(inc + s);
+    const __m128 i1 = _mm_loadu_ps(inc + s + 4);
+    T *p_data = data + s;
+    for (int64_t p = 0; p < periods; p++, p_data += period) {
+      const __m128 n = _mm_set1_ps((float)p);
+      Op(p_data, _mm_add_ps(b0, _mm_mul_ps(i0, n)),
+         _mm_add_ps(b1, _mm_mul_ps(i1, n)));
+    }
+  }
+}
+
+static void mixPeriodsSSE(float *dst, const float *src, int64_t periods,
+                          const float *base, const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const __m128 b0 = _mm_loadu_ps(base + s);
+    const __m128 b1 = _mm_loadu_ps(base + s + 4);
+    const __m128 i0 = _mm_loadu_ps(inc + s);
+    const __m128 i1 = _mm_loadu_ps(inc + s + 4);
+    float *d = dst + s;
+    const float *x = src + s;
+    for (int64_t p = 0; p < periods; p++, d += period, x += period) {
+      const __m128 n = _mm_set1_ps((float)p);
+      const __m128 g0 = _mm_add_ps(b0, _mm_mul_ps(i0, n));
+      const __m128 g1 = _mm_add_ps(b1, _mm_mul_ps(i1, n));
+      _mm_storeu_ps(d, _mm_add_ps(_mm_loadu_ps(d),
+                                  _mm_mul_ps(_mm_loadu_ps(x), g0)));
+      _mm_storeu_ps(d + 4, _mm_add_ps(_mm_loadu_ps(d + 4),
+                                      _mm_mul_ps(_mm_loadu_ps(x + 4), g1)));
+    }
+  }
+}
+
+GAIN_TARGET_AVX2 static inline void fltx8AVX2(float *p, __m256 g) {
+  _mm256_storeu_ps(p, _mm256_mul_ps(_mm256_loadu_ps(p), g));
+}
+
+GAIN_TARGET_AVX2 static inline void s16x8AVX2(int16_t *p, __m256 g) {
+  __m256i x = _mm256_cvtepi16_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+  __m256i r = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(x), g));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                   _mm_packs_epi32(_mm256_castsi256_si128(r),
+                                   _mm256_extracti128_si256(r, 1)));
+}
+
+GAIN_TARGET_AVX2 static inline __m128i s32x4AVX2(__m128i x, __m128 g) {
+  __m256d v = _mm256_mul_pd(_mm256_cvtepi32_pd(x), _mm256_cvtps_pd(g));
+  v = _mm256_min_pd(_mm256_max_pd(v, _mm256_set1_pd(kS32Min)),
+                    _mm256_set1_pd(kS32Max));
+  return _mm256_cvtpd_epi32(v);
+}
+
+GAIN_TARGET_AVX2 static inline void s32x8AVX2(int32_t *p, __m256 g) {
+  __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  __m128i lo = s32x4AVX2(_mm256_castsi256_si128(x), _mm256_castps256_ps128(g));
+  __m128i hi =
+      s32x4AVX2(_mm256_extracti128_si256(x, 1), _mm256_extractf128_ps(g, 1));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p), lo);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 4), hi);
+}
+
+GAIN_TARGET_AVX2 static inline void dblx8AVX2(double *p, __m256 g) {
+  const __m256d g0 = _mm256_cvtps_pd(_mm256_castps256_ps128(g));
+  const __m256d g1 = _mm256_cvtps_pd(_mm256_extractf128_ps(g, 1));
+  _mm256_storeu_pd(p, _mm256_mul_pd(_mm256_loadu_pd(p), g0));
+  _mm256_storeu_pd(p + 4, _mm256_mul_pd(_mm256_loadu_pd(p + 4), g1));
+}
+
+template <typename T, void (*Op)(T *, __m256)>
+GAIN_TARGET_AVX2 static void gainPeriodsAVX2(T *data, int64_t periods,
+                                             const float *base,
+                                             const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const __m256 b = _mm256_loadu_ps(base + s);
+    const __m256 i = _mm256_loadu_ps(inc + s);
+    T *p_data = data + s;
+    for (int64_t p = 0; p < periods; p++, p_data += period) {
+      Op(p_data, _mm256_add_ps(b, _mm256_mul_ps(i, _mm256_set1_ps((float)p))));
+    }
+  }
+}
+
+GAIN_TARGET_AVX2 static void mixPeriodsAVX2(float *dst, const float *src,
+                                            int64_t periods, const float *base,
+                                            const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const __m256 b = _mm256_loadu_ps(base + s);
+    const __m256 i = _mm256_loadu_ps(inc + s);
+    float *d = dst + s;
+    const float *x = src + s;
+    for (int64_t p = 0; p < periods; p++, d += period, x += period) {
+      const __m256 g =
+          _mm256_add_ps(b, _mm256_mul_ps(i, _mm256_set1_ps((float)p)));
+      _mm256_storeu_ps(d, _mm256_add_ps(_mm256_loadu_ps(d),
+                                        _mm256_mul_ps(_mm256_loadu_ps(x), g)));
+    }
+  }
+}
+
+static bool cpuHasAvx2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  // 还要求操作系统保存 YMM 寄存器
+  __cpuid(info, 1);
+  if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#elif GAIN_USE_NEON
+static inline void fltx8NEON(float *p, float32x4_t g0, float32x4_t g1) {
+  vst1q_f32(p, vmulq_f32(vld1q_f32(p), g0));
+  vst1q_f32(p + 4, vmulq_f32(vld1q_f32(p + 4), g1));
+}
+
+static inline void s16x8NEON(int16_t *p, float32x4_t g0, float32x4_t g1) {
+  int16x8_t x = vld1q_s16(p);
+  float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+  float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+  int32x4_t rlo = vcvtnq_s32_f32(vmulq_f32(lo, g0));
+  int32x4_t rhi = vcvtnq_s32_f32(vmulq_f32(hi, g1));
+  vst1q_s16(p, vcombine_s16(vqmovn_s32(rlo), vqmovn_s32(rhi)));
+}
+
+#if defined(__aarch64__)
+// 双精度 NEON 只在 AArch64 上可用，32 位 ARM 的 S32/DBL 走标量实现
+static inline void s32x4NEON(int32_t *p, float32x4_t g) {
+  const float64x2_t lo_limit = vdupq_n_f64(kS32Min);
+  const float64x2_t hi_limit = vdupq_n_f64(kS32Max);
+  int32x4_t x = vld1q_s32(p);
+  float64x2_t lo = vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))),
+                             vcvt_f64_f32(vget_low_f32(g)));
+  float64x2_t hi = vmulq_f64(vcvtq_f64_s64(vmovl_high_s32(x)),
+                             vcvt_high_f64_f32(g));
+  lo = vminq_f64(vmaxq_f64(lo, lo_limit), hi_limit);
+  hi = vminq_f64(vmaxq_f64(hi, lo_limit), hi_limit);
+  vst1q_s32(p, vcombine_s32(vmovn_s64(vcvtnq_s64_f64(lo)),
+                            vmovn_s64(vcvtnq_s64_f64(hi))));
+}
+
+static inline void s32x8NEON(int32_t *p, float32x4_t g0, float32x4_t g1) {
+  s32x4NEON(p, g0);
+  s32x4NEON(p + 4, g1);
+}
+
+static inline void dblx4NEON(double *p, float32x4_t g) {
+  vst1q_f64(p, vmulq_f64(vld1q_f64(p), vcvt_f64_f32(vget_low_f32(g))));
+  vst1q_f64(p + 2, vmulq_f64(vld1q_f64(p + 2), vcvt_high_f64_f32(g)));
+}
+
+static inline void dblx8NEON(double *p, float32x4_t g0, float32x4_t g1) {
+  dblx4NEON(p, g0);
+  dblx4NEON(p + 4, g1);
+}
+#endif
+
+template <typename T, void (*Op)(T *, float32x4_t, float32x4_t)>
+static void gainPeriodsNEON(T *data, int64_t periods, const float *base,
+                            const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const float32x4_t b0 = vld1q_f32(base + s);
+    const float32x4_t b1 = vld1q_f32(base + s + 4);
+    const float32x4_t i0 = vld1q_f32(inc + s);
+    const float32x4_t i1 = vld1q_f32(inc + s + 4);
+    T *p_data = data + s;
+    for (int64_t p = 0; p < periods; p++, p_data += period) {
+      const float n = (float)p;
+      Op(p_data, vmlaq_n_f32(b0, i0, n), vmlaq_n_f32(b1, i1, n));
+    }
+  }
+}
+
+static void mixPeriodsNEON(float *dst, const float *src, int64_t periods,
+                           const float *base, const float *inc, int period) {
+  for (int s = 0; s < period; s += kLanes) {
+    const float32x4_t b0 = vld1q_f32(base + s);
+    const float32x4_t b1 = vld1q_f32(base + s + 4);
+    const float32x4_t i0 = vld1q_f32(inc + s);
+    const float32x4_t i1 = vld1q_f32(inc + s + 4);
+    float *d = dst + s;
+    const float *x = src + s;
+    for (int64_t p = 0; p < periods; p++, d += period, x += period) {
+      const float n = (float)p;
+      vst1q_f32(d, vmlaq_f32(vld1q_f32(d), vld1q_f32(x),
+                             vmlaq_n_f32(b0, i0, n)));
+      vst1q_f32(d + 4, vmlaq_f32(vld1q_f32(d + 4), vld1q_f32(x + 4),
+                                 vmlaq_n_f32(b1, i1, n)));
+    }
+  }
+}
+#endif
+
+template <typename T>
+using GainKernel = void (*)(T *data, int64_t periods, const float *base,
+                            const float *inc, int period);
+
+using MixKernel = void (*)(float *dst, const float *src, int64_t periods,
+                           const float *base, const float *inc, int period);
+
+struct GainKernels {
+  const char *name;
+  GainKernel<float> flt;
+  GainKernel<int16_t> s16;
+  GainKernel<int32_t> s32;
+  GainKernel<double> dbl;
+  MixKernel mix;
+};
+
+static GainKernels selectKernels() {
+#if GAIN_USE_SSE
+  if (cpuHasAvx2()) {
+    return {"avx2",
+            gainPeriodsAVX2<float, fltx8AVX2>,
+            gainPeriodsAVX2<int16_t, s16x8AVX2>,
+            gainPeriodsAVX2<int32_t, s32x8AVX2>,
+            gainPeriodsAVX2<double, dblx8AVX2>,
+            mixPeriodsAVX2};
+  }
+  return {"sse2",
+          gainPeriodsSSE<float, fltx8SSE>,
+          gainPeriodsSSE<int16_t, s16x8SSE>,
+          gainPeriodsSSE<int32_t, s32x8SSE>,
+          gainPeriodsSSE<double, dblx8SSE>,
+          mixPeriodsSSE};
+#elif GAIN_USE_NEON
+  return {"neon",
+          gainPeriodsNEON<float, fltx8NEON>,
+          gainPeriodsNEON<int16_t, s16x8NEON>,
+#if defined(__aarch64__)
+          gainPeriodsNEON<int32_t, s32x8NEON>,
+          gainPeriodsNEON<double, dblx8NEON>,
+#else
+          gainPeriodsScalar<int32_t>,
+          gainPeriodsScalar<double>,
+#endif
+          mixPeriodsNEON};
+#else
+  return {"scalar",
+          gainPeriodsScalar<float>,
+          gainPeriodsScalar<int16_t>,
+          gainPeriodsScalar<int32_t>,
+          gainPeriodsScalar<double>,
+          mixPeriodsScalar};
+#endif
+}
+
+static const GainKernels &kernels() {
+  static const GainKernels k = selectKernels();
+  return k;
+}
+
+const char *gainKernelName() { return kernels().name; }
+
+// 声道数超过展开上限时逐采样计算增益
+template <typename T>
+static void rampScalar(T *data, int64_t frames, int channels,
+                       const float *start, const float *end) {
+  for (int c = 0; c < channels; c++) {
+    auto step = (end[c] - start[c]) / frames;
+    for (int64_t f = 0; f < frames; f++) {
+      auto &v = data[f * channels + c];
+      v = scaleSample(v, start[c] + step * f);
+    }
+  }
+}
+
+// 展开一个周期的起始增益和每周期的增量，返回周期的采样数
+static int planRamp(int64_t frames, int channels, const float *start,
+                    const float *end, float *base, float *inc) {
+  const int period = kLanes / std::gcd(kLanes, channels) * channels;
+  const int64_t period_frames = period / channels;
+  for (int s = 0; s < period; s++) {
+    int c = s % channels;
+    auto step = (end[c] - start[c]) / frames;
+    base[s] = start[c] + step * (s / channels);
+    inc[s] = step * period_frames;
+  }
+  return period;
+}
+
+template <typename T>
+static void ramp(T *data, int64_t frames, int channels, const float *start,
+                 const float *end, GainKernel<T> kernel) {
+  if (channels > kMaxChannels) {
+    rampScalar(data, frames, channels, start, end);
+    return;
+  }
+  float base[kMaxPeriod];
+  float inc[kMaxPeriod];
+  const int period = planRamp(frames, channels, start, end, base, inc);
+  const int64_t samples = frames * channels;
+  const int64_t periods = samples / period;
+  kernel(data, periods, base, inc, period);
+  // 不足一个周期的尾部
+  T *tail = data + periods * period;
+  for (int64_t s = 0; s < samples - periods * period; s++) {
+    tail[s] = scaleSample(tail[s], base[s] + inc[s] * periods);
+  }
+}
+
+bool applyGainRamp(AVSampleFormat format, uint8_t *data, int64_t frames,
+                   int channels, const float *start, const float *end) {
+  if (!data || frames <= 0 || channels <= 0) {
+    return true;
+  }
+  switch (format) {
+  case AV_SAMPLE_FMT_U8:
+    ramp(data, frames, channels, start, end, gainPeriodsScalar<uint8_t>);
+    return true;
+  case AV_SAMPLE_FMT_S16:
+    ramp(reinterpret_cast<int16_t *>(data), frames, channels, start, end,
+         kernels().s16);
+    return true;
+  case AV_SAMPLE_FMT_S32:
+    ramp(reinterpret_cast<int32_t *>(data), frames, channels, start, end,
+         kernels().s32);
+    return true;
+  case AV_SAMPLE_FMT_S64:
+    ramp(reinterpret_cast<int64_t *>(data), frames, channels, start, end,
+         gainPeriodsScalar<int64_t>);
+    return true;
+  case AV_SAMPLE_FMT_FLT:
+    ramp(reinterpret_cast<float *>(data), frames, channels, start, end,
+         kernels().flt);
+    return true;
+  case AV_SAMPLE_FMT_DBL:
+    ramp(reinterpret_cast<double *>(data), frames, channels, start, end,
+         kernels().dbl);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void mixGainRamp(float *dst, const float *src, int64_t frames, int channels,
+                 float start, float end) {
+  if (!dst || !src || frames <= 0 || channels <= 0) {
+    return;
+  }
+  if (channels > kMaxChannels) {
+    const float step = (end - start) / frames;
+    for (int64_t f = 0; f < frames; f++) {
+      const float gain = start + step * f;
+      for (int c = 0; c < channels; c++) {
+        dst[f * channels + c] += src[f * channels + c] * gain;
+      }
+    }
+    return;
+  }
+  float starts[kMaxChannels];
+  float ends[kMaxChannels];
+  std::fill(starts, starts + channels, start);
+  std::fill(ends, ends + channels, end);
+  float base[kMaxPeriod];
+  float inc[kMaxPeriod];
+  const int period = planRamp(frames, channels, starts, ends, base, inc);
+  const int64_t samples = frames * channels;
+  const int64_t periods = samples / period;
+  kernels().mix(dst, src, periods, base, inc, period);
+  const int64_t done = periods * period;
+  for (int64_t s = 0; s < samples - done; s++) {
+    dst[done + s] += src[done + s] * (base[s] + inc[s] * periods);
+  }
+}
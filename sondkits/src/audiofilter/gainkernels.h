@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+// 向量化的逐声道增益：交错数据中声道 c 的增益在整块内从 start[c] 线性过渡到
+// end[c]，音量变化分摊到一个块上，不会出现阶跃引起的拉链噪声；
+// start 与 end 相同时即为固定增益
+// 指令集在首次调用时按 CPU 选择：x86 上有 AVX2 时用 AVX2，否则 SSE2；
+// ARM 上用 NEON；其他平台为标量实现
+// 支持 U8/S16/S32/S64/FLT/DBL 交错格式，其他格式返回 false；
+// U8/S64 只有标量实现，32 位 ARM 上 S32/DBL 也是标量实现
+bool applyGainRamp(AVSampleFormat format, uint8_t *data, int64_t frames,
+                   int channels, const float *start, const float *end);
+// 混音累加：交错 float 的 dst += src * 增益，所有声道的增益在整块内
+// 从 start 线性过渡到 end，第 f 帧为 start + (end - start) * f / frames
+void mixGainRamp(float *dst, const float *src, int64_t frames, int channels,
+                 float start, float end);
+// 当前使用的实现，如 "avx2"、"sse2"、"neon"、"scalar"
+const char *gainKernelName();
@@ -1,7 +1,9 @@
 #include "audioplay.h"
 #include "common.h"
+#include "threadschedule.h"
 #include <QDebug>
 #include <QFile>
+#include <QThread>
 #include <QtGlobal>
 #include <fstream>
 #include <memory>
@@ -13,6 +15,13 @@ PCMDataSourceDevice::PCMDataSourceDevice(
 }
 
 qint64 PCMDataSourceDevice::readData(char *data, qint64 size) {
+  // 部分后端(如 Qt6 的 Darwin、PulseAudio)在设备所属线程即 GUI 线程上拉取，
+  // 不能提升；只有 Qt 另建的音频线程首次回调时才登记并提升调度
+  if (QThread::currentThread() != thread() &&
+      std::this_thread::get_id() != m_sink_thread) {
+    m_sink_thread = std::this_thread::get_id();
+    promoteCurrentThread(ThreadRole::Sink);
+  }
 #if PRINT_CONSUME_TIME
   auto start = std::chrono::high_resolution_clock::now();
 #endif
@@ -35,7 +44,7 @@ qint64 PCMDataSourceDevice::writeData(const char *, qint64) { return -1; }
 AudioPlay::AudioPlay(QAudioFormat audio_format,
                      std::shared_ptr<DataSource> source, QObject *parent)
     : QObject(parent), m_audio_format(audio_format), m_volume(1.0),
-      m_balance(0.0) {
+      m_balance(0.0), m_started(false) {
 
   auto audiodevice = QMediaDevices::defaultAudioOutput();
   if (!audiodevice.isFormatSupported(audio_format)) {
@@ -61,6 +70,7 @@ void AudioPlay::play() {
     return;
   }
   m_audio_sink->start(m_pcm_source.get());
+  m_started = true;
   // if (m_audio_sink->state() == QAudio::StoppedState) {
   //   // m_pcm_data_source->clear();
 
@@ -70,11 +80,22 @@ void AudioPlay::play() {
 }
 
 void AudioPlay::stop() {
+  m_started = false;
   if (m_audio_sink->state() == QAudio::ActiveState) {
     m_audio_sink->stop();
   }
 }
 
+void AudioPlay::restartIfEnded() {
+  if (!m_started || !m_pcm_source) {
+    return;
+  }
+  auto state = m_audio_sink->state();
+  if (state == QAudio::StoppedState || state == QAudio::IdleState) {
+    m_audio_sink->start(m_pcm_source.get());
+  }
+}
+
 void AudioPlay::pause() {
   if (m_audio_sink->state() == QAudio::ActiveState) {
     m_audio_sink->suspend();
@@ -6,6 +6,7 @@
 #include <QtMultimedia/QAudioSink>
 #include <QtMultimedia/QMediaDevices>
 #include <memory>
+#include <thread>
 
 class PCMDataSourceDevice;
 class AudioPlay : public QObject {
@@ -19,6 +20,8 @@ public:
   void play();
   void stop();
   void pause();
+  // 播放到结尾后设备已停止拉取，seek 回来时重新开始；暂停或未播放时不处理
+  void restartIfEnded();
   bool isPlaying();
   void setSinkVoulme(float volume);
   float sinkVolume();
@@ -33,6 +36,8 @@ private:
   std::shared_ptr<PCMDataSourceDevice> m_pcm_source;
   float m_volume;
   float m_balance;
+  // play 之后、stop 之前
+  bool m_started;
 };
 
 class PCMDataSourceDevice : public QIODevice {
@@ -49,4 +54,6 @@ public:
 
 private:
   std::shared_ptr<DataSource> m_data_source;
+  // 已按 Sink 角色提升过调度的拉取线程
+  std::thread::id m_sink_thread;
 };
\ No newline at end of file
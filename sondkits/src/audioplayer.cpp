@@ -4,27 +4,196 @@
 #include "audioeffectsfilter.h"
 #include "audioplay.h"
 #include "audioutils.h"
-#include "decodedatasource.h"
+#include "filterchain.h"
+#include "loopdatasource.h"
+#include "multistreamdecoder.h"
+#include "pcmcache.h"
+#include "pcmtilecache.h"
+#include "playlistdatasource.h"
+#include "threadschedule.h"
+#include <algorithm>
 #include <chrono>
+#include <future>
+#include <iostream>
 extern "C" {
 #include "aubio.h"
 }
 
 AudioPlayer::AudioPlayer(QObject *parent)
     : QObject(parent), m_audio_play(nullptr), m_effects_filter(nullptr),
-      m_stoped(false) {}
+      m_stoped(false) {
+#if USE_REALTIME_THREADS
+  // 播放链路用实时调度，分析线程降低优先级，避免批量分析抢占播放
+  ThreadSchedule sink_schedule;
+  sink_schedule.policy = ThreadPolicy::Fifo;
+  sink_schedule.priority = 20;
+  sink_schedule.nice = -15;
+  setThreadSchedule(ThreadRole::Sink, sink_schedule);
+
+  ThreadSchedule decode_schedule;
+  decode_schedule.policy = ThreadPolicy::RoundRobin;
+  decode_schedule.priority = 10;
+  decode_schedule.nice = -10;
+  setThreadSchedule(ThreadRole::Decode, decode_schedule);
+
+  ThreadSchedule worker_schedule;
+  worker_schedule.policy = ThreadPolicy::Normal;
+  worker_schedule.nice = 10;
+  setThreadSchedule(ThreadRole::Worker, worker_schedule);
+#endif
+}
 
-AudioPlayer::~AudioPlayer() {}
+AudioPlayer::~AudioPlayer() { cancelPreload(); }
 
 void AudioPlayer::open(const std::filesystem::path &in_fpath) {
   m_in_fpath = in_fpath;
+  m_byte_source.reset();
+  openPlayback(nullptr);
+}
+
+void AudioPlayer::open(std::shared_ptr<ByteSource> source) {
+  m_in_fpath.clear();
+  m_byte_source = source;
+  openPlayback(nullptr);
+}
+
+// 管道、标准输入等只能读一遍，再打开一次会从播放的流里抢走数据
+bool AudioPlayer::isStreamInput() const {
+  if (m_byte_source) {
+    return !m_byte_source->seekable();
+  }
+  return StreamByteSource::isStreamPath(m_in_fpath);
+}
+
+void AudioPlayer::openDecoder(std::shared_ptr<AudioDecoder> decoder) {
+  if (m_byte_source) {
+    decoder->open(m_byte_source);
+  } else {
+    decoder->open(m_in_fpath);
+  }
+}
+
+// 解码过的文件直接从 PCM 缓存播放，重播、seek 都不再解码；
+// 否则从头播放到结尾时顺便写入缓存，字节流输入没有文件标识，不经过缓存
+std::shared_ptr<DecodeQueue>
+AudioPlayer::newDecodeQueue(std::shared_ptr<AudioDecoder> decoder) {
+  if (decoder->path().empty() || decoder->byteSource()) {
+    return std::make_shared<DecodeQueue>(decoder);
+  }
+  return std::make_shared<DecodeQueue>(
+      std::make_shared<PCMCacheDecoder>(decoder));
+}
+
+// decode_queue 为空时新建解码器和队列，否则沿用预加载好的队列
+void AudioPlayer::openPlayback(std::shared_ptr<DecodeQueue> decode_queue) {
   m_stoped.store(false);
   // decoder
-  m_audio_decoder = std::make_shared<AudioDecoder>(
-      DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
-  m_audio_decoder->open(in_fpath);
+  m_stem_decoder.reset();
+  m_tile_cache.reset();
+  if (!decode_queue) {
+    m_audio_decoder = std::make_shared<AudioDecoder>(
+        DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+    openDecoder(m_audio_decoder);
+    // 多音轨文件播放时混合所有音轨，单轨解码器仍用于信息和分析；
+    // 流式输入不能再打开一次，只播放默认音轨
+    if (!m_in_fpath.empty() && !isStreamInput() &&
+        MultiStreamDecoder::audioStreamCount(m_audio_decoder->fmtCtx()) > 1) {
+      m_stem_decoder = std::make_shared<MultiStreamDecoder>(
+          DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+      m_stem_decoder->open(m_in_fpath);
+      decode_queue = std::make_shared<DecodeQueue>(m_stem_decoder);
+    }
+  }
+
+  auto audio_format = outputFormat();
+  createEffectsFilter();
+
+  // decode queue
+  m_decode_queue = decode_queue;
+  if (!m_decode_queue) {
+    m_decode_queue = newDecodeQueue(m_audio_decoder);
+  }
+
+  // data source
+  m_playlist_source.reset();
+  m_playlist_durations.clear();
+  m_data_source = std::make_shared<LoopDataSource>(
+      m_filter_chain, audio_format.bytesPerFrame(), m_decode_queue);
+  m_data_source->open();
+
+  m_audio_play = std::make_unique<AudioPlay>(audio_format, m_data_source, this);
+}
+
+// 后台打开下一曲并预解码 lead_ms，探测和首帧解码不占用切换时间
+void AudioPlayer::preload(const std::filesystem::path &in_fpath,
+                          int64_t lead_ms) {
+  cancelPreload();
+  m_preload_fpath = in_fpath;
+  m_preload_task = std::async(std::launch::async, [this, in_fpath, lead_ms]() {
+    auto decoder = std::make_shared<AudioDecoder>(
+        DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+    decoder->open(in_fpath);
+    auto decode_queue = newDecodeQueue(decoder);
+    decode_queue->setPrerollLead(lead_ms);
+    decode_queue->start();
+    m_preload_decoder = decoder;
+    m_preload_queue = decode_queue;
+  });
+}
+
+bool AudioPlayer::playPreloaded() {
+  if (!m_preload_task.valid()) {
+    return false;
+  }
+  try {
+    m_preload_task.get();
+  } catch (const std::exception &e) {
+    std::cout << "### preload failed: " << e.what() << std::endl;
+    cancelPreload();
+    return false;
+  }
+  auto decoder = std::move(m_preload_decoder);
+  auto decode_queue = std::move(m_preload_queue);
+  m_in_fpath = m_preload_fpath;
+  m_byte_source.reset();
+  m_preload_fpath.clear();
+
+  if (!m_data_source || !m_audio_play) {
+    m_audio_decoder = decoder;
+    openPlayback(decode_queue);
+    play();
+    return true;
+  }
+  // 输出设备、滤镜都不重建，读线程下一次回调时切换队列
+  m_stoped.store(false);
+  m_audio_decoder = decoder;
+  m_stem_decoder.reset();
+  m_tile_cache.reset();
+  m_decode_queue = decode_queue;
+  m_data_source->clearLoop();
+  m_data_source->switchQueue(decode_queue);
+  if (!isPlaying()) {
+    play();
+  }
+  return true;
+}
 
-  // audio play
+void AudioPlayer::cancelPreload() {
+  if (m_preload_task.valid()) {
+    try {
+      m_preload_task.get();
+    } catch (const std::exception &) {
+    }
+  }
+  if (m_preload_queue) {
+    m_preload_queue->stop();
+  }
+  m_preload_queue.reset();
+  m_preload_decoder.reset();
+  m_preload_fpath.clear();
+}
+
+QAudioFormat AudioPlayer::outputFormat() const {
   QAudioFormat audio_format;
   audio_format.setSampleRate(m_audio_decoder->targetSampleRate());
   audio_format.setChannelCount(m_audio_decoder->targetChannels());
@@ -44,8 +213,10 @@ void AudioPlayer::open(const std::filesystem::path &in_fpath) {
   default:
     assert(false);
   }
+  return audio_format;
+}
 
-  // filter
+void AudioPlayer::createEffectsFilter() {
   AudioEffectsFilterConfig filter_config;
   filter_config.sample_rate = m_audio_decoder->targetSampleRate();
   filter_config.channels = m_audio_decoder->targetChannels();
@@ -53,15 +224,70 @@ void AudioPlayer::open(const std::filesystem::path &in_fpath) {
   filter_config.max_tempo = MAX_TEMPO;
   m_effects_filter = std::make_shared<AudioEffectsFilter>(filter_config);
 
-  // decode queue
-  auto decode_queue = std::make_shared<DecodeQueue>(m_audio_decoder);
+  FilterChainConfig chain_config;
+  chain_config.sample_rate = filter_config.sample_rate;
+  chain_config.channels = filter_config.channels;
+  chain_config.format = filter_config.format;
+  m_filter_chain = std::make_shared<FilterChain>(chain_config);
+  m_filter_chain->addStage("effects", m_effects_filter);
+}
 
-  // data source
-  auto data_source = std::make_shared<DecodeDataSource>(
-      m_effects_filter, audio_format.bytesPerFrame(), decode_queue);
-  data_source->open();
+void AudioPlayer::openPlaylist(
+    const std::vector<std::filesystem::path> &in_fpaths) {
+  if (in_fpaths.empty()) {
+    return;
+  }
+  cancelPreload();
+  m_stoped.store(false);
+  m_in_fpath = in_fpaths.front();
+  m_byte_source.reset();
+  m_stem_decoder.reset();
+  m_tile_cache.reset();
+  m_decode_queue.reset();
+  m_data_source.reset();
+  m_playlist_durations.clear();
+
+  // 第一曲的解码器决定输出格式，所有曲目都解码到同一目标格式
+  m_audio_decoder = std::make_shared<AudioDecoder>(
+      DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+  m_audio_decoder->open(m_in_fpath);
+  auto audio_format = outputFormat();
+  createEffectsFilter();
+
+  m_playlist_source = std::make_shared<PlaylistDataSource>(
+      m_filter_chain, audio_format.bytesPerFrame());
+  m_playlist_durations.push_back(
+      (int64_t)(m_audio_decoder->duration() * 1000));
+  m_playlist_source->append(newDecodeQueue(m_audio_decoder));
+  for (size_t i = 1; i < in_fpaths.size(); i++) {
+    enqueue(in_fpaths[i]);
+  }
+  m_playlist_source->open();
+
+  m_audio_play =
+      std::make_unique<AudioPlay>(audio_format, m_playlist_source, this);
+}
+
+// 只打开解码器(探测结果已缓存时很快)，队列在成为下一曲时才开始解码
+void AudioPlayer::enqueue(const std::filesystem::path &in_fpath) {
+  if (!m_playlist_source) {
+    openPlaylist({in_fpath});
+    return;
+  }
+  auto decoder = std::make_shared<AudioDecoder>(
+      DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+  try {
+    decoder->open(in_fpath);
+  } catch (const std::exception &e) {
+    std::cout << "### enqueue failed: " << e.what() << std::endl;
+    return;
+  }
+  m_playlist_durations.push_back((int64_t)(decoder->duration() * 1000));
+  m_playlist_source->append(newDecodeQueue(decoder));
+}
 
-  m_audio_play = std::make_unique<AudioPlay>(audio_format, data_source, this);
+int AudioPlayer::playlistIndex() {
+  return m_playlist_source ? m_playlist_source->currentIndex() : -1;
 }
 
 void AudioPlayer::play() {
@@ -91,6 +317,136 @@ bool AudioPlayer::isPlaying() {
   return false;
 }
 
+int64_t AudioPlayer::duration() {
+  // 播放列表模式下为当前曲目的时长
+  if (m_playlist_source) {
+    auto index = m_playlist_source->currentIndex();
+    if (index < 0 || index >= (int)m_playlist_durations.size()) {
+      return 0;
+    }
+    return m_playlist_durations[index];
+  }
+  if (!m_audio_decoder) {
+    return 0;
+  }
+  return (int64_t)(m_audio_decoder->duration() * 1000);
+}
+
+int AudioPlayer::stemCount() {
+  return m_stem_decoder ? m_stem_decoder->stemCount() : 0;
+}
+
+void AudioPlayer::setStemVolume(int stem, float volume) {
+  if (m_stem_decoder) {
+    m_stem_decoder->setStemVolume(stem, volume);
+  }
+}
+
+// 解码队列与滤镜状态在读线程上一起冲刷，输出设备不停止
+int64_t AudioPlayer::seek(int64_t time_ms) {
+  if (m_playlist_source) {
+    time_ms = std::clamp<int64_t>(time_ms, 0, duration());
+    m_playlist_source->seek(time_ms);
+    if (m_audio_play) {
+      m_audio_play->restartIfEnded();
+    }
+    return time_ms;
+  }
+  // 管道等流式输入不能 seek
+  if (!m_decode_queue || !m_audio_decoder->seekable()) {
+    return 0;
+  }
+  time_ms = std::clamp<int64_t>(time_ms, 0, duration());
+  m_data_source->clearLoop();
+  m_data_source->seek(time_ms);
+  // 已播放到结尾时输出设备已停止
+  if (m_audio_play) {
+    m_audio_play->restartIfEnded();
+  }
+  return time_ms;
+}
+
+bool AudioPlayer::setLoop(int64_t a_ms, int64_t b_ms) {
+  if (!m_data_source || m_stem_decoder || !m_audio_decoder->seekable()) {
+    return false;
+  }
+  a_ms = std::clamp<int64_t>(a_ms, 0, duration());
+  b_ms = std::clamp<int64_t>(b_ms, 0, duration());
+  if (a_ms >= b_ms) {
+    return false;
+  }
+  int64_t sample_rate = m_audio_decoder->targetSampleRate();
+  auto a_frame = a_ms * sample_rate / 1000;
+  auto b_frame = b_ms * sample_rate / 1000;
+  if (auto track = PCMCache::instance().find(*m_audio_decoder)) {
+    return m_data_source->setLoop(track, 0, a_frame, b_frame);
+  }
+  // 未完整缓存时从分块缓存读取这一段，反复调整 A、B 不重复解码；
+  // A 之前多读一点用于接缝淡化
+  auto tile_cache = tileCache();
+  if (!tile_cache) {
+    return false;
+  }
+  static constexpr int64_t kLoopMarginMs = 20;
+  auto start_frame =
+      std::max<int64_t>(a_frame - kLoopMarginMs * sample_rate / 1000, 0);
+  std::vector<uint8_t> pcm((b_frame - start_frame) * tile_cache->frameSize());
+  int64_t frames = 0;
+  try {
+    frames = tile_cache->read(start_frame, b_frame - start_frame, pcm.data());
+  } catch (const std::exception &e) {
+    std::cout << "### decode loop failed: " << e.what() << std::endl;
+    return false;
+  }
+  pcm.resize(frames * tile_cache->frameSize());
+  auto track = std::make_shared<PCMTrack>(
+      tile_cache->sampleRate(), tile_cache->channels(), tile_cache->format(),
+      std::move(pcm));
+  return m_data_source->setLoop(track, start_frame, a_frame, b_frame);
+}
+
+void AudioPlayer::exitLoop() {
+  if (m_data_source) {
+    m_data_source->exitLoop();
+  }
+}
+
+std::shared_ptr<PCMTileCache> AudioPlayer::tileCache() {
+  if (m_tile_cache) {
+    return m_tile_cache;
+  }
+  if (!m_audio_decoder || m_playlist_source || !m_audio_decoder->seekable()) {
+    return nullptr;
+  }
+  try {
+    if (m_byte_source) {
+      m_tile_cache = std::make_shared<PCMTileCache>(
+          m_byte_source, m_audio_decoder->targetSampleRate(),
+          m_audio_decoder->targetChannels(),
+          m_audio_decoder->targetSampleFormat());
+    } else {
+      m_tile_cache = std::make_shared<PCMTileCache>(
+          m_in_fpath, m_audio_decoder->targetSampleRate(),
+          m_audio_decoder->targetChannels(),
+          m_audio_decoder->targetSampleFormat());
+    }
+  } catch (const std::exception &e) {
+    std::cout << "### open tile cache failed: " << e.what() << std::endl;
+  }
+  return m_tile_cache;
+}
+
+std::shared_ptr<FilterChain> AudioPlayer::filterChain() {
+  return m_filter_chain;
+}
+
+DecodeQueueStats AudioPlayer::decodeStats() {
+  if (!m_decode_queue) {
+    return DecodeQueueStats();
+  }
+  return m_decode_queue->stats();
+}
+
 void AudioPlayer::setVolume(float volume) {
   m_effects_filter->setVolume(volume, -1);
 }
@@ -106,13 +462,17 @@ void AudioPlayer::setSemitone(int semitone) {
 }
 
 float AudioPlayer::detectBPMUseSoundtouch() {
-  if (!m_audio_decoder) {
+  // 流式输入只能被播放读取一次，不做分析
+  if (!m_audio_decoder || isStreamInput()) {
     return 0;
   }
   int channels = 1;
   auto new_audio_decoder = std::make_shared<AudioDecoder>(
       m_audio_decoder->sampleRate(), channels, AV_SAMPLE_FMT_FLT);
-  new_audio_decoder->open(m_in_fpath);
+  // 分析时完整解码一遍，顺便建立 seek 索引供之后打开时使用
+  new_audio_decoder->setBuildSeekIndex(true);
+  new_audio_decoder->setFastOpen(true);
+  openDecoder(new_audio_decoder);
 
   soundtouch::BPMDetect bpm(channels, m_audio_decoder->sampleRate());
 
@@ -122,6 +482,10 @@ float AudioPlayer::detectBPMUseSoundtouch() {
                      num_samples);
     return !m_stoped.load();
   });
+#if PRINT_CONSUME_TIME
+  std::cout << "### decode buffer allocations: "
+            << new_audio_decoder->bufferAllocations() << std::endl;
+#endif
   new_audio_decoder->close();
   if (m_stoped.load()) {
     return 0;
@@ -131,13 +495,19 @@ float AudioPlayer::detectBPMUseSoundtouch() {
 }
 
 float AudioPlayer::detectBPMUseAubio() {
-  if (!m_audio_decoder) {
+  // 流式输入只能被播放读取一次，不做分析
+  if (!m_audio_decoder || isStreamInput()) {
     return 0;
   }
-  int channels = 1;
+  // 按源文件的声道解码为平面 float，MP3/AAC 等解码器本身输出 FLTP 时
+  // 不需要重采样器；各声道在送入 aubio 前直接按平面取平均
+  int channels = std::max(m_audio_decoder->channels(), 1);
   auto new_audio_decoder = std::make_shared<AudioDecoder>(
-      m_audio_decoder->sampleRate(), channels, AV_SAMPLE_FMT_FLT);
-  new_audio_decoder->open(m_in_fpath);
+      m_audio_decoder->sampleRate(), channels, AV_SAMPLE_FMT_FLTP);
+  // 分析时完整解码一遍，顺便建立 seek 索引供之后打开时使用
+  new_audio_decoder->setBuildSeekIndex(true);
+  new_audio_decoder->setFastOpen(true);
+  openDecoder(new_audio_decoder);
 
   int hop_size = 96;
   int buf_size = 512;
@@ -161,33 +531,40 @@ float AudioPlayer::detectBPMUseAubio() {
     return 0;
   }
 
-  int hop_byte_size = hop_size * sizeof(float);
   int batch_size = 1024;
-  int batch_byte_size = hop_byte_size * batch_size;
-
-  foreachDecoderData(
-      new_audio_decoder,
-      [&](uint8_t *data, int size) {
-        if (!data || size <= 0) {
-          return true;
-        }
-
-        for (int i = 0; i < size / hop_byte_size; i++) {
-          fvec_zeros(input_vec);
-          memcpy(input_vec->data, data + i * hop_byte_size, hop_byte_size);
-          aubio_tempo_do(tempo, input_vec, output_vec);
+  int64_t batch_samples = int64_t(hop_size) * batch_size;
+  const float weight = 1.0f / channels;
+
+  // 除最后一次外每次都是整数个 hop，只有结尾不足一个 hop 的部分补零
+  auto sink = [&](uint8_t *const *planes, int64_t nb_samples) {
+    for (int64_t offset = 0; offset < nb_samples; offset += hop_size) {
+      auto count = std::min<int64_t>(hop_size, nb_samples - offset);
+      fvec_zeros(input_vec);
+      for (int c = 0; c < channels; c++) {
+        auto plane = reinterpret_cast<const float *>(planes[c]) + offset;
+        for (int64_t i = 0; i < count; i++) {
+          input_vec->data[i] += plane[i] * weight;
         }
-
-        if (size % hop_byte_size != 0) {
-          fvec_zeros(input_vec);
-          int offset = size / hop_byte_size * hop_byte_size;
-          memcpy(input_vec->data, data + offset, size - offset);
-          aubio_tempo_do(tempo, input_vec, output_vec);
-        }
-
-        return !m_stoped.load();
-      },
-      batch_byte_size, batch_byte_size);
+      }
+      aubio_tempo_do(tempo, input_vec, output_vec);
+    }
+    return !m_stoped.load();
+  };
+
+  // 需要顺序解码一遍建立 seek 索引时走串行，否则分段并行解码
+  if (new_audio_decoder->isBuildingSeekIndex()) {
+    foreachDecoderPlanarData(new_audio_decoder, sink, batch_samples);
+  } else {
+    ParallelDecodeOptions options;
+    options.ordered = true;
+    options.min_sink_size = batch_samples * sizeof(float);
+    options.max_sink_size = batch_samples * sizeof(float);
+    foreachDecoderPlanarDataParallel(new_audio_decoder, sink, options);
+  }
+#if PRINT_CONSUME_TIME
+  std::cout << "### decode buffer allocations: "
+            << new_audio_decoder->bufferAllocations() << std::endl;
+#endif
 
   float bpm = 0;
   if (!m_stoped.load()) {
@@ -217,6 +594,12 @@ AudioInfo AudioPlayer::fetchAudioInfo() {
   std::cout << "### detct bpm duration: " << duration.count() << "ms";
 #endif
 
+#if PRINT_SEEK_BENCHMARK
+  if (!m_in_fpath.empty() && !isStreamInput()) {
+    benchmarkSeek(m_in_fpath);
+  }
+#endif
+
   info.channels = m_audio_decoder->channels();
   info.sample_rate = m_audio_decoder->sampleRate();
   info.duration_seconds = (int)m_audio_decoder->duration();
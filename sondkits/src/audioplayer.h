@@ -2,7 +2,9 @@
 
 #include <QObject>
 #include <filesystem>
+#include <future>
 #include <memory>
+#include <vector>
 
 struct AudioInfo {
   float bpm;
@@ -16,7 +18,16 @@ struct AudioInfo {
 
 class AudioPlay;
 class AudioEffectsFilter;
+class FilterChain;
 class AudioDecoder;
+class ByteSource;
+class QAudioFormat;
+class DecodeQueue;
+class LoopDataSource;
+class PCMTileCache;
+class PlaylistDataSource;
+class MultiStreamDecoder;
+struct DecodeQueueStats;
 class AudioPlayer : public QObject {
   Q_OBJECT
 public:
@@ -25,28 +36,83 @@ public:
 
   AudioInfo fetchAudioInfo();
   void open(const std::filesystem::path &in_fpath);
+  // 从内存或映射文件等字节来源播放，分析解码共享同一来源
+  void open(std::shared_ptr<ByteSource> source);
+  // 预加载下一曲：后台打开解码器并预先缓冲 lead_ms 的 PCM
+  void preload(const std::filesystem::path &in_fpath, int64_t lead_ms = 2000);
+  // 切换到预加载的曲目，只交换解码队列，没有可用的预加载时返回 false
+  bool playPreloaded();
+  void cancelPreload();
+  // 无缝播放列表：曲目之间没有间隙，输出设备和滤镜不重建，
+  // 当前曲目播放时下一曲已在预解码
+  void openPlaylist(const std::vector<std::filesystem::path> &in_fpaths);
+  // 追加到播放列表末尾
+  void enqueue(const std::filesystem::path &in_fpath);
+  // 当前曲目在播放列表中的序号，不在播放列表模式时为 -1
+  int playlistIndex();
   void play();
   void pause();
   void stop();
   bool isPlaying();
   int64_t duration();
   int64_t seek(int64_t time_ms);
+  // A-B 循环：[a_ms, b_ms) 从内存中的 PCM 循环播放，接缝处交叉淡化；
+  // 已完整解码过的文件直接使用 PCM 缓存，否则从分块缓存读取这一段
+  // 播放列表、多音轨和不可 seek 的输入不支持，返回 false
+  bool setLoop(int64_t a_ms, int64_t b_ms);
+  // 播放到 B 后继续向后播放
+  void exitLoop();
+  // 当前曲目按采样位置随机读取 PCM(波形、拖动试听)，输出格式与播放相同；
+  // 播放列表和不可 seek 的输入返回空
+  std::shared_ptr<PCMTileCache> tileCache();
   void setVolume(float volume);
   void setVolumeBalance(float balance);
   void setTempo(float tempo);
   void setSemitone(int semitone);
+  // 多音轨文件的分轨数，单轨文件为 0
+  int stemCount();
+  //[0.0, 1.0]，播放中可实时调节
+  void setStemVolume(int stem, float volume);
+  // 输出滤镜链，默认只有变速变调和音量一级("effects")，
+  // 可以在其后追加均衡器、限幅器等，并查看各级的延迟和耗时
+  std::shared_ptr<FilterChain> filterChain();
+  // 解码线程空闲统计，暂停或缓冲已满时空闲比例应接近 100%
+  DecodeQueueStats decodeStats();
 signals:
   void signal_update_time(int64_t time_seconds);
   void signal_play_finished();
 
 private:
+  void openPlayback(std::shared_ptr<DecodeQueue> decode_queue);
+  // 按 m_audio_decoder 的目标格式创建输出格式和滤镜
+  QAudioFormat outputFormat() const;
+  void createEffectsFilter();
+  bool isStreamInput() const;
+  void openDecoder(std::shared_ptr<AudioDecoder> decoder);
+  std::shared_ptr<DecodeQueue>
+  newDecodeQueue(std::shared_ptr<AudioDecoder> decoder);
   float detectBPMUseSoundtouch();
   float detectBPMUseAubio();
 
 private:
   std::unique_ptr<AudioPlay> m_audio_play;
   std::shared_ptr<AudioEffectsFilter> m_effects_filter;
+  std::shared_ptr<FilterChain> m_filter_chain;
   std::shared_ptr<AudioDecoder> m_audio_decoder;
+  std::shared_ptr<MultiStreamDecoder> m_stem_decoder;
+  std::shared_ptr<DecodeQueue> m_decode_queue;
+  std::shared_ptr<LoopDataSource> m_data_source;
+  std::shared_ptr<PCMTileCache> m_tile_cache;
+  // playlist
+  std::shared_ptr<PlaylistDataSource> m_playlist_source;
+  std::vector<int64_t> m_playlist_durations;
   std::filesystem::path m_in_fpath;
+  std::shared_ptr<ByteSource> m_byte_source;
+
+  // preload
+  std::future<void> m_preload_task;
+  std::filesystem::path m_preload_fpath;
+  std::shared_ptr<AudioDecoder> m_preload_decoder;
+  std::shared_ptr<DecodeQueue> m_preload_queue;
   std::atomic<bool> m_stoped;
 };
\ No newline at end of file
@@ -1,60 +1,483 @@
 #include "audioutils.h"
+#include "common.h"
 #include "decode/audiodecoder.h"
 #include "decodedatasource.h"
 #include "decodequeue.h"
+#include "pcmcache.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
 extern "C" {
 #include <libavutil/avutil.h>
 }
 
+// 缓存是只读的，sink 可能原地修改数据，按块拷贝后交付
+static void foreachTrackData(std::shared_ptr<const PCMTrack> track,
+                             std::function<bool(uint8_t *, int64_t)> &sink,
+                             int64_t max_sink_size) {
+  const int64_t chunk_size =
+      std::max<int64_t>(max_sink_size / track->frameSize(), 1) *
+      track->frameSize();
+  std::vector<uint8_t> buffer(chunk_size);
+  for (int64_t offset = 0; offset < track->size(); offset += chunk_size) {
+    auto len = std::min(chunk_size, track->size() - offset);
+    memcpy(buffer.data(), track->data() + offset, len);
+    if (!sink(buffer.data(), len)) {
+      break;
+    }
+  }
+}
+
 void foreachDecoderData(std::shared_ptr<AudioDecoder> audio_decoder,
                         std::function<bool(uint8_t *, int64_t)> sink,
                         int64_t min_sink_size, int64_t max_sink_size) {
-  if (!audio_decoder || !sink) {
+  if (!audio_decoder || !sink || audio_decoder->planes() != 1) {
     return;
   }
 
   int64_t frame_size =
       audio_decoder->targetChannels() *
       av_get_bytes_per_sample(audio_decoder->targetSampleFormat());
+  if (max_sink_size <= 0) {
+    max_sink_size = frame_size * 1024;
+  }
+
+  // 同一文件、同一目标格式已经完整解码过时直接读缓存
+  if (auto track = PCMCache::instance().find(*audio_decoder)) {
+    foreachTrackData(track, sink, max_sink_size);
+    return;
+  }
 
-  std::shared_ptr<DecodeQueue> decode_queue =
-      std::make_shared<DecodeQueue>(audio_decoder);
+  // 从头解码到结尾后，解码结果写入 PCM 缓存
+  std::shared_ptr<DecodeQueue> decode_queue = std::make_shared<DecodeQueue>(
+      std::make_shared<PCMCacheDecoder>(audio_decoder));
+  decode_queue->setThreadRole(ThreadRole::Worker);
   DecodeDataSource source(nullptr, frame_size, decode_queue);
   source.open();
 
   if (min_sink_size <= 0) {
     min_sink_size = frame_size;
   }
-  if (max_sink_size <= 0) {
-    max_sink_size = frame_size * 1024;
-  }
 
   int64_t frame_count = max_sink_size / frame_size;
   if (frame_count <= 0) {
     return;
   }
-  int64_t buffer_size = frame_size * frame_count;
-  buffer_size = std::min(buffer_size, max_sink_size);
 
-  uint8_t *buffer = (uint8_t *)av_mallocz(buffer_size);
   while (!source.isEnd()) {
-    int readed = 0;
-    while (!source.isEnd() && readed < min_sink_size) {
-      int r = source.readData(buffer + readed, buffer_size - readed);
-      if (r > 0) {
-        readed += r;
+    // 直接把解码队列环形缓冲区里的数据交给 sink，省去一次拷贝，
+    // 无数据时阻塞，空视图表示已结束；解码队列的内存可写
+    auto span = source.acquireRead(min_sink_size, max_sink_size);
+    if (span.size <= 0) {
+      break;
+    }
+    auto con = sink(const_cast<uint8_t *>(span.data), span.size);
+    source.commitRead(span.size);
+    if (!con) {
+      break;
+    }
+  }
+  source.close();
+}
+
+void foreachDecoderPlanarData(
+    std::shared_ptr<AudioDecoder> audio_decoder,
+    std::function<bool(uint8_t *const *, int64_t)> sink,
+    int64_t max_samples) {
+  if (!audio_decoder || !sink) {
+    return;
+  }
+  const int planes = audio_decoder->planes();
+  // 交错格式时一个"采样"包含所有声道
+  const int64_t sample_size =
+      av_get_bytes_per_sample(audio_decoder->targetSampleFormat()) *
+      (planes == 1 ? audio_decoder->targetChannels() : 1);
+  if (sample_size <= 0) {
+    return;
+  }
+  if (max_samples <= 0) {
+    max_samples = 1024;
+  }
+
+  auto decode_queue = std::make_shared<DecodeQueue>(audio_decoder);
+  decode_queue->setThreadRole(ThreadRole::Worker);
+  decode_queue->start();
+
+  const int64_t plane_size = max_samples * sample_size;
+  std::vector<uint8_t> buffer(plane_size * planes);
+  std::vector<uint8_t *> plane_data(planes);
+  while (true) {
+    // 攒满一块再交付，无数据时在解码队列上阻塞，返回 <= 0 表示已结束
+    int64_t filled = 0;
+    while (filled < plane_size) {
+      for (int i = 0; i < planes; i++) {
+        plane_data[i] = buffer.data() + i * plane_size + filled;
+      }
+      auto r = decode_queue->readPlanarData(plane_data.data(),
+                                            plane_size - filled);
+      if (r <= 0) {
+        break;
       }
+      filled += r;
+    }
+    for (int i = 0; i < planes; i++) {
+      plane_data[i] = buffer.data() + i * plane_size;
+    }
+    if (filled <= 0 || !sink(plane_data.data(), filled / sample_size) ||
+        filled < plane_size) {
+      break;
+    }
+  }
+  decode_queue->stop();
+}
+
+namespace {
+// 按平面存放的一段采样：planes 个平面依次排列，相隔 capacity 个采样；
+// 交错格式只有一个平面，一个"采样"包含所有声道
+class SampleBlock {
+public:
+  SampleBlock(int planes, int64_t sample_size, int64_t capacity)
+      : m_sample_size(sample_size), m_capacity(capacity), m_samples(0),
+        m_data(planes * capacity * sample_size), m_planes(planes) {}
+
+  int64_t samples() const { return m_samples; }
+  int64_t room() const { return m_capacity - m_samples; }
+
+  uint8_t *const *planes(int64_t offset = 0) {
+    for (size_t i = 0; i < m_planes.size(); i++) {
+      m_planes[i] =
+          m_data.data() + (i * m_capacity + offset) * m_sample_size;
+    }
+    return m_planes.data();
+  }
+
+  // 追加各平面 src[i] + offset 起的 count 个采样
+  void append(const uint8_t *const *src, int64_t offset, int64_t count) {
+    for (size_t i = 0; i < m_planes.size(); i++) {
+      memcpy(m_data.data() + (i * m_capacity + m_samples) * m_sample_size,
+             src[i] + offset * m_sample_size, count * m_sample_size);
     }
-    if (readed > 0) {
-      auto con = sink(buffer, readed);
-      if (!con) {
+    m_samples += count;
+  }
+
+  // 丢弃开头的 count 个采样
+  void consume(int64_t count) {
+    for (size_t i = 0; i < m_planes.size(); i++) {
+      auto plane = m_data.data() + i * m_capacity * m_sample_size;
+      memmove(plane, plane + count * m_sample_size,
+              (m_samples - count) * m_sample_size);
+    }
+    m_samples -= count;
+  }
+
+private:
+  int64_t m_sample_size;
+  int64_t m_capacity;
+  int64_t m_samples;
+  std::vector<uint8_t> m_data;
+  std::vector<uint8_t *> m_planes;
+};
+
+struct DecodeSegment {
+  std::deque<SampleBlock> chunks;
+  int64_t buffered = 0;
+  bool done = false;
+};
+
+using PlanarSink = std::function<bool(uint8_t *const *, int64_t)>;
+
+// 交错和平面格式共用，按单个平面的采样数分块；时长未知等情况返回 false，
+// 由调用方退化为串行解码
+bool decodeParallel(std::shared_ptr<AudioDecoder> audio_decoder,
+                    PlanarSink &sink, ParallelDecodeOptions options) {
+  int thread_count = options.thread_count;
+  if (thread_count <= 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  int segment_count = options.segment_count;
+  if (segment_count <= 0) {
+    segment_count = thread_count * 4;
+  }
+  int64_t duration_ms = (int64_t)(audio_decoder->duration() * 1000);
+  auto byte_source = audio_decoder->byteSource();
+  bool seekable = !byte_source || byte_source->seekable();
+  // 已在 PCM 缓存中时由 foreachDecoderData 直接读缓存
+  bool cached = audio_decoder->planes() == 1 &&
+                PCMCache::instance().find(*audio_decoder) != nullptr;
+  if (duration_ms <= 0 || segment_count <= 1 || thread_count <= 1 ||
+      !seekable || cached) {
+    return false;
+  }
+  // 每段至少 1 秒，避免切得过碎
+  segment_count = (int)std::min<int64_t>(
+      segment_count, std::max<int64_t>(duration_ms / 1000, 1));
+  thread_count = std::min(thread_count, segment_count);
+
+  const int planes = audio_decoder->planes();
+  const int64_t sample_size =
+      av_get_bytes_per_sample(audio_decoder->targetSampleFormat()) *
+      (planes == 1 ? audio_decoder->targetChannels() : 1);
+  int64_t max_sink_size = options.max_sink_size;
+  if (max_sink_size <= 0) {
+    max_sink_size = sample_size * 1024;
+  }
+  const int64_t chunk_samples = max_sink_size / sample_size;
+  if (chunk_samples <= 0) {
+    return true;
+  }
+  const int64_t min_samples = std::min(
+      (std::max<int64_t>(options.min_sink_size, 0) + sample_size - 1) /
+          sample_size,
+      chunk_samples);
+
+  std::vector<DecodeSegment> segments(segment_count);
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<int> next_segment(0);
+  std::atomic<bool> stopped(false);
+  std::exception_ptr error;
+
+  // 每段末尾的块不满，不足 min_samples 的部分留到下一块前面一起交付；
+  // 只在持有 mutex(无序)或调用线程(有序)上使用
+  SampleBlock pending(planes, sample_size, min_samples + chunk_samples);
+  auto feed = [&](SampleBlock &chunk) -> bool {
+    if (pending.samples() == 0 && chunk.samples() >= min_samples) {
+      return sink(chunk.planes(), chunk.samples());
+    }
+    pending.append(chunk.planes(), 0, chunk.samples());
+    int64_t offset = 0;
+    bool con = true;
+    while (con && pending.samples() - offset >= min_samples &&
+           offset < pending.samples()) {
+      auto count = std::min(pending.samples() - offset, chunk_samples);
+      con = sink(pending.planes(offset), count);
+      offset += count;
+    }
+    pending.consume(offset);
+    return con;
+  };
+
+  auto deliver = [&](int index, SampleBlock &&chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (options.ordered) {
+      // 调用线程还在交付前面的段时，限制后面的段缓存的数据量
+      auto &segment = segments[index];
+      if (options.max_segment_buffer > 0) {
+        cv.wait(lock, [&]() {
+          return stopped.load() ||
+                 segment.buffered < options.max_segment_buffer;
+        });
+      }
+      segment.buffered += chunk.samples() * sample_size * planes;
+      segment.chunks.push_back(std::move(chunk));
+      cv.notify_all();
+    } else if (!stopped.load() && !feed(chunk)) {
+      stopped.store(true);
+    }
+  };
+
+  auto decode_segment = [&](int index) {
+    auto decoder = std::make_shared<AudioDecoder>(
+        audio_decoder->targetSampleRate(), audio_decoder->targetChannels(),
+        audio_decoder->targetSampleFormat());
+    decoder->setFastOpen(true);
+    // 字节来源按偏移读取，各段解码器可以共享
+    if (byte_source) {
+      decoder->open(byte_source);
+    } else {
+      decoder->open(audio_decoder->path());
+    }
+    if (index > 0) {
+      decoder->seek(duration_ms * index / segment_count);
+    }
+    if (index < segment_count - 1) {
+      decoder->setEndPosition(duration_ms * (index + 1) / segment_count);
+    }
+
+    SampleBlock chunk(planes, sample_size, chunk_samples);
+    std::vector<const uint8_t *> src(planes);
+    while (!stopped.load() && !decoder->isEnd()) {
+      auto &frames = decoder->decodeNextFrameData();
+      for (auto &frame : frames) {
+        const int64_t samples =
+            frame.data ? frame.planeSize() / sample_size : 0;
+        for (int i = 0; i < planes && frame.data; i++) {
+          src[i] = frame.plane(i);
+        }
+        int64_t offset = 0;
+        while (offset < samples) {
+          auto count = std::min(samples - offset, chunk.room());
+          chunk.append(src.data(), offset, count);
+          offset += count;
+          if (chunk.room() == 0) {
+            deliver(index, std::move(chunk));
+            chunk = SampleBlock(planes, sample_size, chunk_samples);
+          }
+        }
+        decoder->freeData(frame);
+      }
+    }
+    if (chunk.samples() > 0) {
+      deliver(index, std::move(chunk));
+    }
+    decoder->close();
+  };
+
+  auto worker = [&]() {
+    promoteCurrentThread(ThreadRole::Worker);
+    while (!stopped.load()) {
+      int index = next_segment.fetch_add(1);
+      if (index >= segment_count) {
         break;
       }
+      try {
+        decode_segment(index);
+      } catch (...) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        stopped.store(true);
+      }
+      std::unique_lock<std::mutex> lock(mutex);
+      segments[index].done = true;
+      cv.notify_all();
     }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < thread_count; i++) {
+    workers.emplace_back(worker);
   }
-  av_freep(&buffer);
-  source.close();
+
+  if (options.ordered) {
+    // 调用线程按段顺序交付，后面的段先解完时先缓存
+    for (int i = 0; i < segment_count && !stopped.load(); i++) {
+      while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() -> bool {
+          return stopped.load() || !segments[i].chunks.empty() ||
+                 segments[i].done;
+        });
+        if (stopped.load() || segments[i].chunks.empty()) {
+          break;
+        }
+        auto chunk = std::move(segments[i].chunks.front());
+        segments[i].chunks.pop_front();
+        segments[i].buffered -= chunk.samples() * sample_size * planes;
+        cv.notify_all();
+        lock.unlock();
+        if (!feed(chunk)) {
+          stopped.store(true);
+          cv.notify_all();
+          break;
+        }
+      }
+    }
+  }
+
+  for (auto &t : workers) {
+    t.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  // 最后剩下的零头
+  if (!stopped.load() && pending.samples() > 0) {
+    sink(pending.planes(), pending.samples());
+  }
+  return true;
+}
+} // namespace
+
+void foreachDecoderDataParallel(std::shared_ptr<AudioDecoder> audio_decoder,
+                                std::function<bool(uint8_t *, int64_t)> sink,
+                                ParallelDecodeOptions options) {
+  if (!audio_decoder || !sink || audio_decoder->planes() != 1) {
+    return;
+  }
+  const int64_t frame_size =
+      audio_decoder->targetChannels() *
+      av_get_bytes_per_sample(audio_decoder->targetSampleFormat());
+  PlanarSink planar_sink = [&](uint8_t *const *planes, int64_t frames) {
+    return sink(planes[0], frames * frame_size);
+  };
+  if (!decodeParallel(audio_decoder, planar_sink, options)) {
+    foreachDecoderData(audio_decoder, sink, options.min_sink_size,
+                       options.max_sink_size);
+  }
+}
+
+void foreachDecoderPlanarDataParallel(
+    std::shared_ptr<AudioDecoder> audio_decoder,
+    std::function<bool(uint8_t *const *, int64_t)> sink,
+    ParallelDecodeOptions options) {
+  if (!audio_decoder || !sink) {
+    return;
+  }
+  if (!decodeParallel(audio_decoder, sink, options)) {
+    const int64_t sample_size =
+        av_get_bytes_per_sample(audio_decoder->targetSampleFormat()) *
+        (audio_decoder->planes() == 1 ? audio_decoder->targetChannels() : 1);
+    foreachDecoderPlanarData(audio_decoder, sink,
+                             options.max_sink_size / sample_size);
+  }
+}
+
+int64_t benchmarkSeek(const std::filesystem::path &in_fpath, int seek_count) {
+  auto audio_decoder = std::make_shared<AudioDecoder>(
+      DEFAULT_SAMPLE_RATE, DEFAULT_CHANNELS, DEFAULT_SAMPLE_AV_FORMAT);
+  audio_decoder->open(in_fpath);
+  int64_t duration_ms = (int64_t)(audio_decoder->duration() * 1000);
+  if (duration_ms <= 0 || seek_count <= 0) {
+    return -1;
+  }
+
+  DecodeQueue decode_queue(audio_decoder);
+  decode_queue.start();
+
+  int64_t frame_size = audio_decoder->targetChannels() *
+                       av_get_bytes_per_sample(DEFAULT_SAMPLE_AV_FORMAT);
+  std::vector<uint8_t> buffer(frame_size * 1024);
+  int64_t total_us = 0;
+  int64_t max_us = 0;
+  int count = 0;
+  for (int i = 0; i < seek_count; i++) {
+    // 前后跳跃，避免顺序 seek 命中已缓冲的数据
+    int64_t target = duration_ms * ((i * 7) % seek_count) / seek_count;
+    decode_queue.seek(target);
+    while (decode_queue.lastSeekLatency() < 0) {
+      if (decode_queue.readData(buffer.data(), buffer.size()) <= 0) {
+        break;
+      }
+    }
+    auto latency = decode_queue.lastSeekLatency();
+    if (latency < 0) {
+      continue;
+    }
+    total_us += latency;
+    max_us = std::max(max_us, latency);
+    count++;
+  }
+  decode_queue.stop();
+  if (count == 0) {
+    return -1;
+  }
+  // 目标：每次 seek 都在 30ms 内拿到新位置的数据
+  static constexpr int64_t kSeekTargetUs = 30000;
+  std::cout << "### seek benchmark: " << count << " seeks, avg "
+            << total_us / count << "us, max " << max_us << "us, target "
+            << kSeekTargetUs << "us "
+            << (max_us <= kSeekTargetUs ? "met" : "missed") << std::endl;
+  return total_us / count;
 }
 
 int getSemitoneDifference(ChromaticKey fromKey, ChromaticKey toKey) {
@@ -1,12 +1,57 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
 #include <functional>
+#include <memory>
 
 class AudioDecoder;
+// 交错格式输出的解码器，平面格式请使用 foreachDecoderPlanarData
 void foreachDecoderData(std::shared_ptr<AudioDecoder> audio_decoder,
                         std::function<bool(uint8_t *, int64_t)> sink,
                         int64_t min_sink_size = 0, int64_t max_sink_size = 0);
 
+// 按平面交付解码数据：sink(planes, nb_samples)，除最后一次外每次正好
+// max_samples 个采样；交错格式的解码器只有一个平面
+void foreachDecoderPlanarData(
+    std::shared_ptr<AudioDecoder> audio_decoder,
+    std::function<bool(uint8_t *const *, int64_t)> sink,
+    int64_t max_samples = 0);
+
+struct ParallelDecodeOptions {
+  // <=0 时使用硬件线程数
+  int thread_count = 0;
+  // <=0 时为线程数的 4 倍
+  int segment_count = 0;
+  // true: 按时间顺序交给 sink(在调用线程上)；
+  // false: 谁先解完谁先交付(在工作线程上串行调用)，适合与顺序无关的分析
+  bool ordered = true;
+  // 段与段之间的零头会拼接起来，除最后一次外每次交付都不少于 min_sink_size；
+  // 平面格式时两者都是单个平面的字节数
+  int64_t min_sink_size = 0;
+  int64_t max_sink_size = 0;
+  // 顺序交付时每段最多缓存的字节数，达到后该段的工作线程等待，<=0 不限制
+  int64_t max_segment_buffer = 8 * 1024 * 1024;
+};
+
+// 把文件按时间切成若干段，每段用独立的 AudioDecoder 在线程池上并发解码。
+// audio_decoder 需已打开，只作为路径和目标格式的模板，输出需为交错格式；
+// 时长未知时退化为 foreachDecoderData
+void foreachDecoderDataParallel(std::shared_ptr<AudioDecoder> audio_decoder,
+                                std::function<bool(uint8_t *, int64_t)> sink,
+                                ParallelDecodeOptions options = {});
+// 按平面交付的版本，sink 与 foreachDecoderPlanarData 相同；
+// 不能并行时退化为 foreachDecoderPlanarData
+void foreachDecoderPlanarDataParallel(
+    std::shared_ptr<AudioDecoder> audio_decoder,
+    std::function<bool(uint8_t *const *, int64_t)> sink,
+    ParallelDecodeOptions options = {});
+
+// 在文件上做 seek_count 次分散的 seek，统计从请求到读到新数据的耗时
+// 返回平均耗时(us)，失败返回 -1
+int64_t benchmarkSeek(const std::filesystem::path &in_fpath,
+                      int seek_count = 20);
+
 enum ChromaticKey {
   // 大调调性 (0-11)
   C_MAJOR = 0,
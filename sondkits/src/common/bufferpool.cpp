@@ -0,0 +1,89 @@
+#include "bufferpool.h"
+#include <mutex>
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+// 块头记录块大小，保持 64 字节对齐
+static constexpr int64_t kBlockHeaderSize = 64;
+
+BufferPool::BufferPool() : m_block_size(0), m_allocations(0) {
+  m_free_blocks.reserve(64);
+}
+
+BufferPool::~BufferPool() { clear(); }
+
+void BufferPool::reserve(int64_t block_size) {
+  std::lock_guard<SpinLock> lock(m_lock);
+  if (block_size <= m_block_size) {
+    return;
+  }
+  m_block_size = block_size;
+  for (auto block : m_free_blocks) {
+    freeBlock(block);
+  }
+  m_free_blocks.clear();
+}
+
+uint8_t *BufferPool::acquire(int64_t size) {
+  if (size <= 0) {
+    return nullptr;
+  }
+  if (size > blockSize()) {
+    reserve(size);
+  }
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    if (!m_free_blocks.empty()) {
+      auto block = m_free_blocks.back();
+      m_free_blocks.pop_back();
+      return block;
+    }
+  }
+  return allocBlock();
+}
+
+void BufferPool::release(uint8_t *data) {
+  if (!data) {
+    return;
+  }
+  auto block_size = *reinterpret_cast<int64_t *>(data - kBlockHeaderSize);
+  std::lock_guard<SpinLock> lock(m_lock);
+  if (block_size < m_block_size) {
+    // 块大小已调大，旧块直接释放
+    freeBlock(data);
+    return;
+  }
+  m_free_blocks.push_back(data);
+}
+
+void BufferPool::clear() {
+  std::lock_guard<SpinLock> lock(m_lock);
+  for (auto block : m_free_blocks) {
+    freeBlock(block);
+  }
+  m_free_blocks.clear();
+}
+
+int64_t BufferPool::blockSize() const {
+  std::lock_guard<SpinLock> lock(m_lock);
+  return m_block_size;
+}
+
+int64_t BufferPool::allocations() const { return m_allocations.load(); }
+
+uint8_t *BufferPool::allocBlock() {
+  int64_t block_size = blockSize();
+  auto raw = static_cast<uint8_t *>(av_malloc(kBlockHeaderSize + block_size));
+  if (!raw) {
+    return nullptr;
+  }
+  *reinterpret_cast<int64_t *>(raw) = block_size;
+  m_allocations.fetch_add(1);
+  return raw + kBlockHeaderSize;
+}
+
+void BufferPool::freeBlock(uint8_t *data) {
+  auto raw = data - kBlockHeaderSize;
+  av_free(raw);
+}
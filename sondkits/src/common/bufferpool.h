@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// 定长 PCM 缓冲池
+// 所有块大小相同(取见过的最大帧大小)，释放后回收到空闲链表复用，
+// 稳态下 acquire/release 不会产生堆分配
+class BufferPool {
+public:
+  BufferPool();
+  ~BufferPool();
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  // 预设块大小，比当前块大时丢弃已缓存的小块
+  void reserve(int64_t block_size);
+  uint8_t *acquire(int64_t size);
+  void release(uint8_t *data);
+  void clear();
+
+  int64_t blockSize() const;
+  // 累计的堆分配次数，稳态播放时应保持不变
+  int64_t allocations() const;
+
+private:
+  uint8_t *allocBlock();
+  void freeBlock(uint8_t *data);
+
+private:
+  mutable SpinLock m_lock;
+  std::vector<uint8_t *> m_free_blocks;
+  int64_t m_block_size;
+  std::atomic<int64_t> m_allocations;
+};
@@ -3,6 +3,7 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libswresample/swresample.h>
 }
+#include <system_error>
 #include <thread>
 
 std::string avErr2String(int errnum) {
@@ -11,6 +12,22 @@ std::string avErr2String(int errnum) {
   return std::string(errbuf);
 }
 
+bool mediaFileKey(const std::filesystem::path &media_path, int64_t *file_size,
+                  int64_t *mtime) {
+  std::error_code ec;
+  auto size = std::filesystem::file_size(media_path, ec);
+  if (ec) {
+    return false;
+  }
+  auto time = std::filesystem::last_write_time(media_path, ec);
+  if (ec) {
+    return false;
+  }
+  *file_size = static_cast<int64_t>(size);
+  *mtime = static_cast<int64_t>(time.time_since_epoch().count());
+  return true;
+}
+
 void SpinLock::lock() {
   while (flag.test_and_set(std::memory_order_acquire)) {
     std::this_thread::yield();
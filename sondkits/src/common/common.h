@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <filesystem>
 #include <string>
 
 // ffplay -f s16le -ar 44100 -ch_layout stereo decode.pcm
@@ -9,6 +11,13 @@
 
 #define PRINT_CONSUME_TIME 1
 #define USE_AUBIO_BPM 1
+#define PRINT_SEEK_BENCHMARK 0
+#define USE_REALTIME_THREADS 0
+// 后台读文件使用 io_uring(仅 Linux，需要 liburing)，运行时不可用时退回 pread
+// 由 CMake 选项 USE_IO_URING 在找到 liburing 时定义为 1
+#ifndef USE_IO_URING
+#define USE_IO_URING 0
+#endif
 #define DEFAULT_SAMPLE_RATE 44100
 #define DEFAULT_CHANNELS 2
 #define DEFAULT_SAMPLE_AV_FORMAT AV_SAMPLE_FMT_FLT
@@ -28,3 +37,7 @@ public:
 };
 
 std::string avErr2String(int errnum);
+
+// 媒体文件的身份：大小 + 修改时间，用于判断缓存/索引是否过期
+bool mediaFileKey(const std::filesystem::path &media_path, int64_t *file_size,
+                  int64_t *mtime);
@@ -0,0 +1,196 @@
+#include "filereader.h"
+#include "common.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if USE_IO_URING && defined(__linux__) && __has_include(<liburing.h>)
+#define HAVE_IO_URING 1
+#include <liburing.h>
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#if HAVE_IO_URING
+// 一次提交的读取请求数上限
+static const unsigned kRingEntries = 8;
+#endif
+
+#ifdef _WIN32
+FileReader::FileReader(const std::filesystem::path &path)
+    : m_file(INVALID_HANDLE_VALUE), m_size(0), m_ring(nullptr) {
+  m_file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                       nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Failed to open file: " + path.u8string());
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size)) {
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to get file size: " + path.u8string());
+  }
+  m_size = size.QuadPart;
+}
+
+FileReader::~FileReader() {
+  if (m_file != INVALID_HANDLE_VALUE) {
+    CloseHandle(m_file);
+  }
+}
+
+// 同步句柄上指定 OVERLAPPED 偏移读取，不依赖也不移动文件指针
+int64_t FileReader::readAt(int64_t offset, uint8_t *data, int64_t size) {
+  int64_t readed = 0;
+  while (readed < size) {
+    OVERLAPPED overlapped = {};
+    auto pos = offset + readed;
+    overlapped.Offset = static_cast<DWORD>(pos & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(pos >> 32);
+    auto len = static_cast<DWORD>(std::min<int64_t>(size - readed, INT_MAX));
+    DWORD r = 0;
+    if (!ReadFile(m_file, data + readed, len, &r, &overlapped)) {
+      if (GetLastError() == ERROR_HANDLE_EOF) {
+        break;
+      }
+      return -1;
+    }
+    if (r == 0) {
+      break;
+    }
+    readed += r;
+  }
+  return readed;
+}
+#else
+FileReader::FileReader(const std::filesystem::path &path)
+    : m_fd(-1), m_size(0), m_ring(nullptr) {
+  m_fd = ::open(path.c_str(), O_RDONLY);
+  if (m_fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path.u8string());
+  }
+  struct stat st;
+  if (fstat(m_fd, &st) != 0) {
+    ::close(m_fd);
+    throw std::runtime_error("Failed to stat file: " + path.u8string());
+  }
+  m_size = static_cast<int64_t>(st.st_size);
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#if HAVE_IO_URING
+  // 内核不支持或被禁用(容器、seccomp)时退回 pread
+  m_ring = new io_uring;
+  if (io_uring_queue_init(kRingEntries, m_ring, 0) < 0) {
+    delete m_ring;
+    m_ring = nullptr;
+  }
+#endif
+}
+
+FileReader::~FileReader() {
+#if HAVE_IO_URING
+  close_ring();
+#endif
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+int64_t FileReader::readAt(int64_t offset, uint8_t *data, int64_t size) {
+  int64_t readed = 0;
+  while (readed < size) {
+    auto len = std::min<int64_t>(size - readed, INT_MAX);
+    auto r = pread(m_fd, data + readed, len, offset + readed);
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (r == 0) {
+      break;
+    }
+    readed += r;
+  }
+  return readed;
+}
+#endif
+
+void FileReader::readBatch(Request *requests, int count) {
+  int begin = 0;
+#if HAVE_IO_URING
+  for (; m_ring && begin < count; begin += kRingEntries) {
+    read_ring(requests + begin, std::min<int>(count - begin, kRingEntries));
+  }
+#endif
+  for (; begin < count; begin++) {
+    auto &request = requests[begin];
+    request.result = readAt(request.offset, request.data, request.size);
+  }
+}
+
+#if HAVE_IO_URING
+// 返回前收割所有已提交的请求，保证内核不再写入这些缓冲；
+// 提交或等待出错时关闭 io_uring，之后都用 pread
+void FileReader::read_ring(Request *requests, int count) {
+  for (int i = 0; i < count; i++) {
+    auto &request = requests[i];
+    auto sqe = io_uring_get_sqe(m_ring);
+    auto len = (unsigned)std::min<int64_t>(request.size, INT_MAX);
+    io_uring_prep_read(sqe, m_fd, request.data, len, request.offset);
+    io_uring_sqe_set_data64(sqe, i);
+    request.result = -1;
+  }
+  int submitted = io_uring_submit_and_wait(m_ring, count);
+  bool failed = submitted != count;
+  for (int i = 0; i < submitted; i++) {
+    io_uring_cqe *cqe = nullptr;
+    int r;
+    do {
+      r = io_uring_wait_cqe(m_ring, &cqe);
+    } while (r == -EINTR || r == -EAGAIN);
+    if (r < 0) {
+      failed = true;
+      break;
+    }
+    requests[io_uring_cqe_get_data64(cqe)].result = cqe->res;
+    io_uring_cqe_seen(m_ring, cqe);
+  }
+  if (failed) {
+    std::cerr << "io_uring read failed, falling back to pread" << std::endl;
+    close_ring();
+  }
+  // 出错、被信号打断或读得不完整的部分同步补齐
+  for (int i = 0; i < count; i++) {
+    auto &request = requests[i];
+    auto done = std::max<int64_t>(request.result, 0);
+    if (done < request.size && request.offset + done < m_size) {
+      auto r = readAt(request.offset + done, request.data + done,
+                      request.size - done);
+      request.result = r < 0 ? -1 : done + r;
+    }
+  }
+}
+
+void FileReader::close_ring() {
+  if (m_ring) {
+    io_uring_queue_exit(m_ring);
+    delete m_ring;
+    m_ring = nullptr;
+  }
+}
+#endif
+
+bool FileReader::usingIoUring() const { return m_ring != nullptr; }
+
+int64_t FileReader::size() const { return m_size; }
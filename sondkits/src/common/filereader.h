@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+struct io_uring;
+
+// 按偏移读取的只读文件，不移动文件指针，偏移和长度都是 64 位
+// 打开失败时构造函数抛出 std::runtime_error
+// 只应在后台线程上调用，读取可能阻塞
+class FileReader {
+public:
+  struct Request {
+    int64_t offset;
+    uint8_t *data;
+    int64_t size;
+    // 读到的字节数，出错时为 -1
+    int64_t result;
+  };
+
+  explicit FileReader(const std::filesystem::path &path);
+  ~FileReader();
+  FileReader(const FileReader &) = delete;
+  FileReader &operator=(const FileReader &) = delete;
+
+  int64_t size() const;
+  // 读到文件末尾时少于 size，出错时返回 -1
+  int64_t readAt(int64_t offset, uint8_t *data, int64_t size);
+  // 一次提交多个读取；启用 io_uring 时一次系统调用提交全部请求并等待完成，
+  // 否则依次 readAt
+  void readBatch(Request *requests, int count);
+  bool usingIoUring() const;
+
+private:
+  // 以下只在启用 io_uring 时使用
+  void read_ring(Request *requests, int count);
+  void close_ring();
+
+private:
+#ifdef _WIN32
+  void *m_file;
+#else
+  int m_fd;
+#endif
+  int64_t m_size;
+  io_uring *m_ring;
+};
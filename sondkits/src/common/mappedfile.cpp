@@ -0,0 +1,146 @@
+#include "mappedfile.h"
+#include <algorithm>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::filesystem::path &path)
+    : m_data(nullptr), m_size(0), m_file(INVALID_HANDLE_VALUE),
+      m_mapping(nullptr) {
+  m_file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                       nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+  if (m_file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Failed to open file: " + path.u8string());
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(m_file, &size)) {
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to get file size: " + path.u8string());
+  }
+  m_size = size.QuadPart;
+  if (m_size == 0) {
+    return;
+  }
+  m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_mapping) {
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to map file: " + path.u8string());
+  }
+  m_data = static_cast<const uint8_t *>(
+      MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_data) {
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    throw std::runtime_error("Failed to map file: " + path.u8string());
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    UnmapViewOfFile(m_data);
+  }
+  if (m_mapping) {
+    CloseHandle(m_mapping);
+  }
+  if (m_file != INVALID_HANDLE_VALUE) {
+    CloseHandle(m_file);
+  }
+}
+
+// 打开文件时已指定 FILE_FLAG_SEQUENTIAL_SCAN
+void MappedFile::adviseAccess(Access) {}
+
+void MappedFile::willNeed(int64_t offset, int64_t size) {
+#if _WIN32_WINNT >= 0x0602
+  offset = std::max<int64_t>(offset, 0);
+  size = std::min(size, m_size - offset);
+  if (!m_data || size <= 0) {
+    return;
+  }
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<uint8_t *>(m_data + offset);
+  range.NumberOfBytes = static_cast<SIZE_T>(size);
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  (void)offset;
+  (void)size;
+#endif
+}
+
+void MappedFile::dontNeed(int64_t, int64_t) {}
+#else
+MappedFile::MappedFile(const std::filesystem::path &path)
+    : m_data(nullptr), m_size(0) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open file: " + path.u8string());
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Failed to stat file: " + path.u8string());
+  }
+  m_size = static_cast<int64_t>(st.st_size);
+  if (m_size > 0) {
+    void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("Failed to map file: " + path.u8string());
+    }
+    m_data = static_cast<const uint8_t *>(addr);
+  }
+  // 映射建立后即可关闭文件描述符
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+  }
+}
+
+// madvise 要求起始地址按页对齐，向下对齐并相应加长
+static void advise(const uint8_t *base, int64_t total, int64_t offset,
+                   int64_t size, int advice) {
+  offset = std::max<int64_t>(offset, 0);
+  size = std::min(size, total - offset);
+  if (!base || size <= 0) {
+    return;
+  }
+  static const int64_t page_size = sysconf(_SC_PAGESIZE);
+  auto aligned = offset / page_size * page_size;
+  madvise(const_cast<uint8_t *>(base + aligned), size + offset - aligned,
+          advice);
+}
+
+void MappedFile::adviseAccess(Access access) {
+  int advice = MADV_NORMAL;
+  if (access == Access::Sequential) {
+    advice = MADV_SEQUENTIAL;
+  } else if (access == Access::Random) {
+    advice = MADV_RANDOM;
+  }
+  advise(m_data, m_size, 0, m_size, advice);
+}
+
+void MappedFile::willNeed(int64_t offset, int64_t size) {
+  advise(m_data, m_size, offset, size, MADV_WILLNEED);
+}
+
+// 只读私有映射的页没有被修改过，丢弃后再访问会从文件重新读入
+void MappedFile::dontNeed(int64_t offset, int64_t size) {
+  advise(m_data, m_size, offset, size, MADV_DONTNEED);
+}
+#endif
+
+const uint8_t *MappedFile::data() const { return m_data; }
+
+int64_t MappedFile::size() const { return m_size; }
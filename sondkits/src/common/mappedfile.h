@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// 只读的整文件内存映射，偏移和长度都是 64 位
+// 映射失败时构造函数抛出 std::runtime_error
+class MappedFile {
+public:
+  enum class Access {
+    Normal,
+    // 顺序读取：内核加大预读，读过的页优先回收
+    Sequential,
+    Random,
+  };
+
+  explicit MappedFile(const std::filesystem::path &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const uint8_t *data() const;
+  int64_t size() const;
+
+  // 以下均为提示，失败或平台不支持时忽略
+  void adviseAccess(Access access);
+  // 提前把 [offset, offset + size) 读入页缓存
+  void willNeed(int64_t offset, int64_t size);
+  // [offset, offset + size) 不再需要，允许回收对应的页
+  void dontNeed(int64_t offset, int64_t size);
+
+private:
+  const uint8_t *m_data;
+  int64_t m_size;
+#ifdef _WIN32
+  void *m_file;
+  void *m_mapping;
+#endif
+};
@@ -0,0 +1,115 @@
+#include "ringbuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+static int64_t roundUpPowerOfTwo(int64_t v) {
+  int64_t p = 1;
+  while (p < v) {
+    p <<= 1;
+  }
+  return p;
+}
+
+RingBuffer::RingBuffer(int64_t capacity)
+    : m_buffer(nullptr), m_capacity(roundUpPowerOfTwo(std::max<int64_t>(
+                             capacity, 1))),
+      m_mask(m_capacity - 1), m_write_pos(0), m_read_pos(0) {
+  m_buffer = static_cast<uint8_t *>(av_malloc(m_capacity));
+  if (!m_buffer) {
+    throw std::runtime_error("Failed to allocate ring buffer");
+  }
+}
+
+RingBuffer::~RingBuffer() { av_freep(&m_buffer); }
+
+int64_t RingBuffer::capacity() const { return m_capacity; }
+
+int64_t RingBuffer::readable() const {
+  return m_write_pos.load(std::memory_order_acquire) -
+         m_read_pos.load(std::memory_order_acquire);
+}
+
+int64_t RingBuffer::writable() const { return m_capacity - readable(); }
+
+int64_t RingBuffer::writePosition() const {
+  return m_write_pos.load(std::memory_order_relaxed);
+}
+
+int64_t RingBuffer::write(const uint8_t *data, int64_t size) {
+  if (!data || size <= 0) {
+    return 0;
+  }
+  const int64_t write_pos = m_write_pos.load(std::memory_order_relaxed);
+  const int64_t read_pos = m_read_pos.load(std::memory_order_acquire);
+  const int64_t len = std::min(size, m_capacity - (write_pos - read_pos));
+  if (len <= 0) {
+    return 0;
+  }
+  const int64_t offset = write_pos & m_mask;
+  const int64_t first = std::min(len, m_capacity - offset);
+  memcpy(m_buffer + offset, data, first);
+  if (len > first) {
+    memcpy(m_buffer, data + first, len - first);
+  }
+  m_write_pos.store(write_pos + len, std::memory_order_release);
+  return len;
+}
+
+int64_t RingBuffer::read(uint8_t *data, int64_t size) {
+  if (!data || size <= 0) {
+    return 0;
+  }
+  const int64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+  const int64_t write_pos = m_write_pos.load(std::memory_order_acquire);
+  const int64_t len = std::min(size, write_pos - read_pos);
+  if (len <= 0) {
+    return 0;
+  }
+  const int64_t offset = read_pos & m_mask;
+  const int64_t first = std::min(len, m_capacity - offset);
+  memcpy(data, m_buffer + offset, first);
+  if (len > first) {
+    memcpy(data + first, m_buffer, len - first);
+  }
+  m_read_pos.store(read_pos + len, std::memory_order_release);
+  return len;
+}
+
+int64_t RingBuffer::acquireRead(uint8_t **data) {
+  const int64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+  const int64_t write_pos = m_write_pos.load(std::memory_order_acquire);
+  const int64_t offset = read_pos & m_mask;
+  *data = m_buffer + offset;
+  return std::min(write_pos - read_pos, m_capacity - offset);
+}
+
+int64_t RingBuffer::commitRead(int64_t size) {
+  const int64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+  const int64_t write_pos = m_write_pos.load(std::memory_order_acquire);
+  const int64_t len = std::min(size, write_pos - read_pos);
+  if (len <= 0) {
+    return 0;
+  }
+  m_read_pos.store(read_pos + len, std::memory_order_release);
+  return len;
+}
+
+int64_t RingBuffer::discardTo(int64_t position) {
+  const int64_t read_pos = m_read_pos.load(std::memory_order_relaxed);
+  const int64_t write_pos = m_write_pos.load(std::memory_order_acquire);
+  const int64_t target = std::min(position, write_pos);
+  if (target <= read_pos) {
+    return 0;
+  }
+  m_read_pos.store(target, std::memory_order_release);
+  return target - read_pos;
+}
+
+void RingBuffer::reset() {
+  m_write_pos.store(0);
+  m_read_pos.store(0);
+}
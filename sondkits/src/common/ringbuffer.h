@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// 单生产者/单消费者的无锁字节环形缓冲区
+// 容量向上取整为 2 的幂，读写位置单调递增，通过掩码映射到缓冲区
+// write 只能在生产者线程调用，read 只能在消费者线程调用
+class RingBuffer {
+public:
+  explicit RingBuffer(int64_t capacity);
+  ~RingBuffer();
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  int64_t capacity() const;
+  int64_t readable() const;
+  int64_t writable() const;
+  // 单调递增的写位置，只能在生产者线程调用
+  int64_t writePosition() const;
+
+  // 最多两次 memcpy，返回实际写入/读取的字节数
+  int64_t write(const uint8_t *data, int64_t size);
+  int64_t read(uint8_t *data, int64_t size);
+  // 零拷贝读取：*data 指向读位置起不跨越回绕点的连续数据，返回其长度；
+  // commitRead 之前写端不会覆盖这段数据，只能在消费者线程调用
+  int64_t acquireRead(uint8_t **data);
+  int64_t commitRead(int64_t size);
+  // 丢弃 position 之前的数据，只能在消费者线程调用
+  int64_t discardTo(int64_t position);
+
+  // 仅在读写双方都停止时调用
+  void reset();
+
+private:
+  uint8_t *m_buffer;
+  int64_t m_capacity;
+  int64_t m_mask;
+
+  // 分开缓存行，避免读写线程伪共享
+  alignas(64) std::atomic<int64_t> m_write_pos;
+  alignas(64) std::atomic<int64_t> m_read_pos;
+};
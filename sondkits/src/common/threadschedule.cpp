@@ -0,0 +1,130 @@
+#include "threadschedule.h"
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+static std::mutex g_schedule_mutex;
+static ThreadSchedule g_schedules[3];
+
+static int roleIndex(ThreadRole role) { return static_cast<int>(role); }
+
+void setThreadSchedule(ThreadRole role, const ThreadSchedule &schedule) {
+  std::lock_guard<std::mutex> lock(g_schedule_mutex);
+  g_schedules[roleIndex(role)] = schedule;
+}
+
+ThreadSchedule threadSchedule(ThreadRole role) {
+  std::lock_guard<std::mutex> lock(g_schedule_mutex);
+  return g_schedules[roleIndex(role)];
+}
+
+#ifdef _WIN32
+static bool applyPriority(const ThreadSchedule &schedule) {
+  int priority = THREAD_PRIORITY_NORMAL;
+  if (schedule.policy == ThreadPolicy::Fifo ||
+      schedule.policy == ThreadPolicy::RoundRobin) {
+    priority = THREAD_PRIORITY_TIME_CRITICAL;
+  } else if (schedule.nice < -10) {
+    priority = THREAD_PRIORITY_HIGHEST;
+  } else if (schedule.nice < 0) {
+    priority = THREAD_PRIORITY_ABOVE_NORMAL;
+  } else if (schedule.nice > 10) {
+    priority = THREAD_PRIORITY_LOWEST;
+  } else if (schedule.nice > 0) {
+    priority = THREAD_PRIORITY_BELOW_NORMAL;
+  }
+  return SetThreadPriority(GetCurrentThread(), priority) != 0;
+}
+
+static bool applyAffinity(const std::vector<int> &cpus) {
+  DWORD_PTR mask = 0;
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < (int)sizeof(DWORD_PTR) * 8) {
+      mask |= DWORD_PTR(1) << cpu;
+    }
+  }
+  return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+#else
+// Linux 上 nice 按线程生效；其他平台 setpriority 会影响整个进程，
+// 改用 QoS 等级近似
+static bool applyNice(int nice) {
+#if defined(__linux__)
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  return setpriority(PRIO_PROCESS, tid, nice) == 0;
+#elif defined(__APPLE__)
+  qos_class_t qos = QOS_CLASS_DEFAULT;
+  if (nice < 0) {
+    qos = QOS_CLASS_USER_INTERACTIVE;
+  } else if (nice > 0) {
+    qos = QOS_CLASS_UTILITY;
+  }
+  return pthread_set_qos_class_self_np(qos, 0) == 0;
+#else
+  (void)nice;
+  return false;
+#endif
+}
+
+static bool applyPriority(const ThreadSchedule &schedule) {
+  if (schedule.policy == ThreadPolicy::Fifo ||
+      schedule.policy == ThreadPolicy::RoundRobin) {
+    int policy = schedule.policy == ThreadPolicy::Fifo ? SCHED_FIFO : SCHED_RR;
+    sched_param param{};
+    param.sched_priority =
+        std::max(sched_get_priority_min(policy),
+                 std::min(schedule.priority, sched_get_priority_max(policy)));
+    if (pthread_setschedparam(pthread_self(), policy, &param) == 0) {
+      return true;
+    }
+    // 没有实时调度权限，退回 nice
+    applyNice(schedule.nice);
+    return false;
+  }
+  return applyNice(schedule.nice);
+}
+
+static bool applyAffinity(const std::vector<int> &cpus) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  // macOS 只有亲和性提示，不支持绑定到指定 CPU
+  (void)cpus;
+  return false;
+#endif
+}
+#endif
+
+bool promoteCurrentThread(ThreadRole role) {
+  auto schedule = threadSchedule(role);
+  bool ok = true;
+  if (schedule.policy != ThreadPolicy::Default) {
+    ok = applyPriority(schedule) && ok;
+  }
+  if (!schedule.cpus.empty()) {
+    ok = applyAffinity(schedule.cpus) && ok;
+  }
+  if (!ok) {
+    std::cerr << "Failed to apply thread schedule for role "
+              << roleIndex(role) << std::endl;
+  }
+  return ok;
+}
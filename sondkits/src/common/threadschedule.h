@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+// 线程角色：播放链路上的线程优先于批量分析线程
+enum class ThreadRole {
+  // DecodeQueue 播放解码线程、多音轨解码线程、后台读文件线程
+  Decode,
+  // 离线分析(分段并行解码、分析用的解码队列)
+  Worker,
+  // QAudioSink 拉取数据的线程，滤镜在这里运行
+  Sink,
+};
+
+enum class ThreadPolicy {
+  // 不修改线程调度
+  Default,
+  // 普通分时调度，只设置 nice
+  Normal,
+  // 实时调度，需要权限(CAP_SYS_NICE/rtprio)，失败时退回 nice
+  RoundRobin,
+  Fifo,
+};
+
+struct ThreadSchedule {
+  ThreadPolicy policy = ThreadPolicy::Default;
+  // 实时优先级，Linux 为 1-99
+  int priority = 0;
+  // Normal 策略或实时调度失败时使用，越小越优先
+  int nice = 0;
+  // 允许运行的 CPU 编号，空表示不限制
+  std::vector<int> cpus;
+};
+
+// 设置某个角色的调度参数，之后启动(或登记)的该角色线程生效
+void setThreadSchedule(ThreadRole role, const ThreadSchedule &schedule);
+ThreadSchedule threadSchedule(ThreadRole role);
+
+// 把当前线程按角色的配置调整调度策略和 CPU 亲和性，
+// 线程启动时调用；返回 false 表示部分设置失败(如缺少实时调度权限)
+bool promoteCurrentThread(ThreadRole role);
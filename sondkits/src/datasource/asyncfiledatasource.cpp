@@ -0,0 +1,241 @@
+#include "asyncfiledatasource.h"
+#include "threadschedule.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+AsyncFileDataSource::AsyncFileDataSource(
+    std::shared_ptr<AudioFilter> audio_filter, int64_t frame_size,
+    const std::filesystem::path &file_path, int64_t buffer_size)
+    : DataSource(audio_filter, frame_size), m_file_path(file_path),
+      m_frame_size(frame_size),
+      m_buffer_size(std::max(buffer_size / frame_size, int64_t(1)) *
+                    frame_size),
+      m_file_size(0), m_current(nullptr), m_read_serial(0), m_read_offset(0),
+      m_seek_offset(0), m_seek_serial(0), m_io_signaled(false),
+      m_io_waiting(false), m_io_stop(false) {}
+
+AsyncFileDataSource::~AsyncFileDataSource() { close(); }
+
+void AsyncFileDataSource::open() {
+  close();
+  try {
+    m_reader = std::make_unique<FileReader>(m_file_path);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return;
+  }
+  m_file_size = m_reader->size();
+  for (auto &buffer : m_buffers) {
+    buffer.data.resize(m_buffer_size);
+    buffer.state.store(kEmpty);
+  }
+  m_current = nullptr;
+  m_read_serial = 0;
+  m_read_offset.store(0);
+  m_seek_offset.store(0);
+  m_seek_serial.store(0);
+  m_io_stop = false;
+  m_io_signaled.store(true);
+  m_io_thread = std::thread(&AsyncFileDataSource::io_loop, this);
+}
+
+void AsyncFileDataSource::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_io_mutex);
+    m_io_stop = true;
+    m_io_cv.notify_all();
+  }
+  if (m_io_thread.joinable()) {
+    m_io_thread.join();
+  }
+  m_reader.reset();
+  m_file_size = 0;
+  m_current = nullptr;
+  m_read_offset.store(0);
+}
+
+bool AsyncFileDataSource::isEnd() const {
+  return !m_reader || m_read_offset.load() >= m_file_size;
+}
+
+int64_t AsyncFileDataSource::bytesAvailable() const {
+  return m_reader ? m_file_size - m_read_offset.load() : 0;
+}
+
+void AsyncFileDataSource::seek(int64_t offset) {
+  offset = std::clamp<int64_t>(offset, 0, m_file_size);
+  m_seek_offset.store(offset / m_frame_size * m_frame_size);
+  m_seek_serial.fetch_add(1, std::memory_order_release);
+  notify_io();
+}
+
+int64_t AsyncFileDataSource::size() const { return m_file_size; }
+
+int64_t AsyncFileDataSource::position() const { return m_read_offset.load(); }
+
+int64_t AsyncFileDataSource::realReadData(uint8_t *data, int64_t maxlen) {
+  if (!m_reader || !data || maxlen <= 0) {
+    return 0;
+  }
+  check_seek();
+  int64_t readed = 0;
+  while (readed < maxlen) {
+    auto buffer = current_buffer();
+    if (!buffer) {
+      break;
+    }
+    auto pos = m_read_offset.load(std::memory_order_relaxed) - buffer->offset;
+    auto len = std::min(buffer->size - pos, maxlen - readed);
+    memcpy(data + readed, buffer->data.data() + pos, len);
+    readed += len;
+    consume(len);
+  }
+  return readed;
+}
+
+PCMSpan AsyncFileDataSource::realAcquireRead(int64_t max_size,
+                                             bool *writable) {
+  *writable = true;
+  if (!m_reader) {
+    return {};
+  }
+  check_seek();
+  auto buffer = current_buffer();
+  if (!buffer) {
+    return {};
+  }
+  auto pos = m_read_offset.load(std::memory_order_relaxed) - buffer->offset;
+  return {buffer->data.data() + pos, std::min(buffer->size - pos, max_size)};
+}
+
+void AsyncFileDataSource::realCommitRead(int64_t size) {
+  if (m_current && size > 0) {
+    consume(size);
+  }
+}
+
+// seek 之后丢弃正在读的缓冲和滤镜中残留的旧采样
+void AsyncFileDataSource::check_seek() {
+  auto serial = m_seek_serial.load(std::memory_order_acquire);
+  if (serial == m_read_serial) {
+    return;
+  }
+  m_read_serial = serial;
+  m_read_offset.store(m_seek_offset.load());
+  if (m_current) {
+    release(*m_current);
+    m_current = nullptr;
+  }
+  resetFilter();
+}
+
+// 找到从读位置开始的已填充缓冲；旧 seek 的数据直接归还给 IO 线程，
+// IO 线程已经按更新的 seek 填充的缓冲留到读端看到该 seek 之后使用
+AsyncFileDataSource::Buffer *AsyncFileDataSource::current_buffer() {
+  if (m_current) {
+    return m_current;
+  }
+  auto offset = m_read_offset.load(std::memory_order_relaxed);
+  for (auto &buffer : m_buffers) {
+    if (buffer.state.load(std::memory_order_acquire) != kFull) {
+      continue;
+    }
+    if (buffer.serial < m_read_serial) {
+      release(buffer);
+      continue;
+    }
+    if (buffer.serial != m_read_serial || buffer.offset != offset) {
+      continue;
+    }
+    if (buffer.size <= 0) {
+      // 读取出错，后面的数据不可用
+      release(buffer);
+      m_read_offset.store(m_file_size);
+      return nullptr;
+    }
+    m_current = &buffer;
+    return m_current;
+  }
+  return nullptr;
+}
+
+void AsyncFileDataSource::consume(int64_t size) {
+  auto offset = m_read_offset.load(std::memory_order_relaxed) + size;
+  m_read_offset.store(offset);
+  if (offset >= m_current->offset + m_current->size) {
+    release(*m_current);
+    m_current = nullptr;
+  }
+}
+
+void AsyncFileDataSource::release(Buffer &buffer) {
+  buffer.state.store(kEmpty, std::memory_order_release);
+  notify_io();
+}
+
+// 只有 IO 线程确实在等待时才短暂获取互斥量
+void AsyncFileDataSource::notify_io() {
+  m_io_signaled.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_io_waiting.load()) {
+    std::lock_guard<std::mutex> lock(m_io_mutex);
+    m_io_cv.notify_one();
+  }
+}
+
+void AsyncFileDataSource::io_loop() {
+  promoteCurrentThread(ThreadRole::Decode);
+  int64_t serial = -1;
+  int64_t fill_offset = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_io_mutex);
+      m_io_waiting.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      m_io_cv.wait(lock, [this]() -> bool {
+        return m_io_stop || m_io_signaled.load();
+      });
+      m_io_waiting.store(false);
+      if (m_io_stop) {
+        break;
+      }
+      m_io_signaled.store(false);
+    }
+    // 填满所有空缓冲，同一批的读取一起提交
+    while (true) {
+      auto seek_serial = m_seek_serial.load(std::memory_order_acquire);
+      if (seek_serial != serial) {
+        serial = seek_serial;
+        fill_offset = m_seek_offset.load();
+      }
+      FileReader::Request requests[2];
+      Buffer *targets[2];
+      int count = 0;
+      for (auto &buffer : m_buffers) {
+        if (fill_offset >= m_file_size ||
+            buffer.state.load(std::memory_order_acquire) != kEmpty) {
+          continue;
+        }
+        auto size = std::min(m_buffer_size, m_file_size - fill_offset);
+        buffer.offset = fill_offset;
+        buffer.serial = serial;
+        requests[count] = {fill_offset, buffer.data.data(), size, 0};
+        targets[count++] = &buffer;
+        fill_offset += size;
+      }
+      if (count == 0) {
+        break;
+      }
+      m_reader->readBatch(requests, count);
+      for (int i = 0; i < count; i++) {
+        if (requests[i].result < 0) {
+          std::cerr << "Error reading file: " << m_file_path.u8string()
+                    << std::endl;
+        }
+        targets[i]->size = std::max<int64_t>(requests[i].result, 0);
+        targets[i]->state.store(kFull, std::memory_order_release);
+      }
+    }
+  }
+}
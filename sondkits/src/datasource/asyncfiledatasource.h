@@ -0,0 +1,86 @@
+#pragma once
+#include "audiofilter.h"
+#include "datasource.h"
+#include "filereader.h"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 原始 PCM 文件的数据源，由后台 IO 线程预读到双缓冲：
+// 读线程消费一块时 IO 线程填充另一块，音频回调只拷贝内存，
+// 不做系统调用、不触发缺页；存储卡顿只消耗缓冲，不会阻塞回调
+// IO 线程在启用 io_uring 时批量提交读取，否则用 pread/ReadFile
+// 缓冲未就绪时本次读取返回已读到的部分(可能为 0)，不等待
+class AsyncFileDataSource : public DataSource {
+public:
+  AsyncFileDataSource(std::shared_ptr<AudioFilter> audio_filter,
+                      int64_t frame_size,
+                      const std::filesystem::path &file_path,
+                      int64_t buffer_size = 1024 * 1024);
+  ~AsyncFileDataSource() override;
+
+  void open() override;
+  void close() override;
+  bool isEnd() const override;
+  int64_t bytesAvailable() const override;
+
+  // 在控制线程调用：按字节偏移(向下对齐到帧)重新开始读取
+  void seek(int64_t offset);
+  int64_t size() const;
+  int64_t position() const;
+
+protected:
+  int64_t realReadData(uint8_t *data, int64_t size) override;
+  // 缓冲由本数据源独占，滤镜可以原地处理
+  PCMSpan realAcquireRead(int64_t max_size, bool *writable) override;
+  void realCommitRead(int64_t size) override;
+
+private:
+  enum BufferState { kEmpty, kFull };
+  struct Buffer {
+    std::vector<uint8_t> data;
+    int64_t offset = 0;
+    int64_t size = 0;
+    // 填充时的 seek 序号，与读端不一致的是 seek 之前的旧数据
+    int64_t serial = 0;
+    std::atomic<int> state{kEmpty};
+  };
+
+  // 以下在读线程上调用
+  void check_seek();
+  Buffer *current_buffer();
+  void consume(int64_t size);
+  void release(Buffer &buffer);
+
+  void notify_io();
+  void io_loop();
+
+private:
+  const std::filesystem::path m_file_path;
+  const int64_t m_frame_size;
+  const int64_t m_buffer_size;
+  std::unique_ptr<FileReader> m_reader;
+  int64_t m_file_size;
+  Buffer m_buffers[2];
+
+  // 读线程状态
+  Buffer *m_current;
+  int64_t m_read_serial;
+  std::atomic<int64_t> m_read_offset;
+
+  // seek
+  std::atomic<int64_t> m_seek_offset;
+  std::atomic<int64_t> m_seek_serial;
+
+  // io
+  std::thread m_io_thread;
+  std::mutex m_io_mutex;
+  std::condition_variable m_io_cv;
+  std::atomic<bool> m_io_signaled;
+  std::atomic<bool> m_io_waiting;
+  bool m_io_stop;
+};
@@ -2,10 +2,18 @@
 #include <QDebug>
 #include <QFile>
 #include <QtGlobal>
+#include <algorithm>
 
 DataSource::DataSource(std::shared_ptr<AudioFilter> audio_filter,
                        int64_t frame_size)
-    : m_audio_filter(audio_filter), m_frame_size(frame_size) {}
+    : m_audio_filter(audio_filter), m_frame_size(frame_size),
+      m_span_consumed(0), m_source_acquired(0) {}
+
+void DataSource::resetFilter() {
+  if (m_audio_filter) {
+    m_audio_filter->reset();
+  }
+}
 
 int64_t DataSource::readData(uint8_t *data, int64_t size) {
   // 确保size 是每一帧的倍数
@@ -36,3 +44,107 @@ int64_t DataSource::readData(uint8_t *data, int64_t size) {
 
   return r;
 }
+
+PCMSpan DataSource::acquireRead(int64_t min_size, int64_t max_size) {
+  // 上次的输出还没有消费完
+  if (m_span_consumed < m_span.size) {
+    return {m_span.data + m_span_consumed, m_span.size - m_span_consumed};
+  }
+  max_size = max_size / m_frame_size * m_frame_size;
+  if (max_size <= 0) {
+    return {};
+  }
+  // min_size 向上取整到整帧
+  min_size = (std::max<int64_t>(min_size, 1) + m_frame_size - 1) /
+             m_frame_size * m_frame_size;
+  min_size = std::min(min_size, max_size);
+
+  while (1) {
+    uint8_t *data = nullptr;
+    int64_t r = 0;
+    bool writable = false;
+    auto span = realAcquireRead(max_size, &writable);
+    // 回绕等原因导致连续数据不足 min_size 时退回拷贝
+    auto len = span.size / m_frame_size * m_frame_size;
+    if (span.data && len >= min_size && (writable || !m_audio_filter)) {
+      data = const_cast<uint8_t *>(span.data);
+      r = len;
+      m_source_acquired = len;
+    } else {
+      r = read_staging(min_size, max_size);
+      data = m_staging.data();
+      m_source_acquired = 0;
+    }
+
+    if (m_audio_filter) {
+      if (r == 0) {
+        if (m_staging.size() < static_cast<size_t>(max_size)) {
+          m_staging.resize(max_size);
+        }
+        data = m_staging.data();
+        r = std::min(m_audio_filter->flushRemaining(), max_size);
+        m_audio_filter->reciveRemaining(data, &r);
+      } else {
+        // 滤镜输出不会多于输入，直接在数据源的内存上原地处理
+        auto result = m_audio_filter->process(data, &r);
+        if (result == AUDIO_PROCESS_RESULT_AGAIN) {
+          realCommitRead(m_source_acquired);
+          m_source_acquired = 0;
+          continue;
+        }
+        if (result != AUDIO_PROCESS_RESULT_SUCCESS) {
+          realCommitRead(m_source_acquired);
+          m_source_acquired = 0;
+          return {};
+        }
+      }
+    }
+    if (r <= 0) {
+      realCommitRead(m_source_acquired);
+      m_source_acquired = 0;
+      return {};
+    }
+    m_span = {data, r};
+    m_span_consumed = 0;
+    return m_span;
+  }
+}
+
+void DataSource::commitRead(int64_t size) {
+  if (size <= 0 || m_span_consumed >= m_span.size) {
+    return;
+  }
+  m_span_consumed = std::min(m_span_consumed + size, m_span.size);
+  if (m_span_consumed < m_span.size) {
+    return;
+  }
+  // 整段输出都已消费，才能把源数据交还给数据源
+  if (m_source_acquired > 0) {
+    realCommitRead(m_source_acquired);
+    m_source_acquired = 0;
+  }
+  m_span = {};
+  m_span_consumed = 0;
+}
+
+int64_t DataSource::read_staging(int64_t min_size, int64_t max_size) {
+  if (m_staging.size() < static_cast<size_t>(max_size)) {
+    m_staging.resize(max_size);
+  }
+  int64_t readed = 0;
+  while (readed < min_size) {
+    auto r = realReadData(m_staging.data() + readed, max_size - readed);
+    if (r <= 0) {
+      break;
+    }
+    readed += r;
+  }
+  return readed;
+}
+
+PCMSpan DataSource::realAcquireRead(int64_t, bool *writable) {
+  *writable = false;
+  return {};
+}
+
+void DataSource::realCommitRead(int64_t) {}
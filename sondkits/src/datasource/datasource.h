@@ -1,7 +1,15 @@
 
 #pragma once
 #include "audiofilter.h"
+#include <cstdint>
 #include <memory>
+#include <vector>
+
+// 数据源内部 PCM 的只读视图，不拷贝数据
+struct PCMSpan {
+  const uint8_t *data = nullptr;
+  int64_t size = 0;
+};
 
 class DataSource {
 public:
@@ -12,11 +20,37 @@ public:
   virtual bool isEnd() const = 0;
   virtual int64_t bytesAvailable() const = 0;
   int64_t readData(uint8_t *data, int64_t size);
+  // 零拷贝读取：返回至少 min_size(数据结束时可能更少)、最多 max_size 字节的
+  // 已经过滤镜处理的数据，数据源能暴露内部内存时直接指向它，否则读入内部缓冲；
+  // 空视图表示数据已结束或出错。用完后 commitRead 消费其中 size 字节，
+  // 未消费完的部分下次 acquireRead 继续返回。两者之间不能调用 readData
+  PCMSpan acquireRead(int64_t min_size, int64_t max_size);
+  void commitRead(int64_t size);
 
 protected:
   virtual int64_t realReadData(uint8_t *data, int64_t size) = 0;
+  // 能直接暴露内部内存的数据源重写：返回读位置起最多 max_size 字节的
+  // 连续视图但不移动读位置，*writable 表示滤镜可以在这段内存上原地处理；
+  // 返回空视图时由基类改用 realReadData 拷贝
+  virtual PCMSpan realAcquireRead(int64_t max_size, bool *writable);
+  // 消费 realAcquireRead 返回的前 size 字节
+  virtual void realCommitRead(int64_t size);
+  // 在读线程上调用，源数据发生跳变时清空滤镜状态
+  void resetFilter();
+
+private:
+  // 拷贝方式读入 staging，至少 min_size 字节，返回读到的字节数
+  int64_t read_staging(int64_t min_size, int64_t max_size);
 
 private:
   std::shared_ptr<AudioFilter> m_audio_filter;
   const int64_t m_frame_size;
+
+  // acquireRead 返回的滤镜输出及已被 commitRead 消费的字节数
+  PCMSpan m_span;
+  int64_t m_span_consumed;
+  // 直接引用数据源内存时，整段输出消费完后要提交给数据源的字节数
+  int64_t m_source_acquired;
+  // 不能直接暴露内存时的中转缓冲
+  std::vector<uint8_t> m_staging;
 };
@@ -6,21 +6,142 @@
 DecodeDataSource::DecodeDataSource(std::shared_ptr<AudioFilter> audio_filter,
                                    int64_t frame_size,
                                    std::shared_ptr<DecodeQueue> decode_queue)
-    : DataSource(audio_filter, frame_size), m_decode_queue(decode_queue) {}
+    : DataSource(audio_filter, frame_size), m_decode_queue(decode_queue),
+      m_flush_serial(decode_queue->flushSerial()), m_keep_filter(false),
+      m_switch_pending(false) {}
 
 int64_t DecodeDataSource::realReadData(uint8_t *data, int64_t maxlen) {
   if (!data || maxlen <= 0) {
     return 0;
   }
-  return m_decode_queue->readData(reinterpret_cast<uint8_t *>(data), maxlen);
+  if (m_switch_pending.load(std::memory_order_acquire)) {
+    swap_queue();
+  }
+  auto r = m_decode_queue->readData(reinterpret_cast<uint8_t *>(data), maxlen);
+  check_flush_serial();
+  return r;
 }
 
-bool DecodeDataSource::isEnd() const { return m_decode_queue->canRead(); }
+PCMSpan DecodeDataSource::realAcquireRead(int64_t max_size, bool *writable) {
+  *writable = true;
+  if (m_switch_pending.load(std::memory_order_acquire)) {
+    swap_queue();
+  }
+  uint8_t *data = nullptr;
+  auto r = m_decode_queue->acquireRead(&data, max_size);
+  check_flush_serial();
+  if (r <= 0) {
+    return {};
+  }
+  return {data, r};
+}
 
-void DecodeDataSource::open() { m_decode_queue->start(); }
+void DecodeDataSource::realCommitRead(int64_t size) {
+  m_decode_queue->commitRead(size);
+}
 
-void DecodeDataSource::close() { m_decode_queue->stop(); }
+// 队列因 seek 丢弃了旧数据，滤镜中残留的旧采样也要一起丢弃
+void DecodeDataSource::check_flush_serial() {
+  auto serial = m_decode_queue->flushSerial();
+  if (serial != m_flush_serial) {
+    m_flush_serial = serial;
+    if (!m_keep_filter.exchange(false)) {
+      resetFilter();
+    }
+  }
+}
+
+bool DecodeDataSource::isEnd() const {
+  std::lock_guard<SpinLock> lock(m_queue_lock);
+  if (m_switch_pending.load()) {
+    return false;
+  }
+  return m_decode_queue->canRead();
+}
+
+void DecodeDataSource::open() {
+  m_decode_queue->setPrerollLead(0);
+  m_decode_queue->start();
+}
+
+void DecodeDataSource::close() {
+  std::shared_ptr<DecodeQueue> pending;
+  {
+    std::lock_guard<SpinLock> lock(m_queue_lock);
+    m_switch_pending.store(false);
+    pending = std::move(m_pending_queue);
+  }
+  if (pending) {
+    pending->stop();
+  }
+  collect_retired_queue();
+  m_decode_queue->stop();
+}
 
 int64_t DecodeDataSource::bytesAvailable() const {
+  std::lock_guard<SpinLock> lock(m_queue_lock);
   return m_decode_queue->bytesAvailable();
 }
+
+void DecodeDataSource::switchQueue(std::shared_ptr<DecodeQueue> decode_queue) {
+  if (!decode_queue) {
+    return;
+  }
+  // 切换后按正常水位继续解码
+  decode_queue->setPrerollLead(0);
+  decode_queue->start();
+  // 回收与设置在同一临界区内，保证读线程换下旧队列时回收槽为空
+  std::shared_ptr<DecodeQueue> retired;
+  {
+    std::lock_guard<SpinLock> lock(m_queue_lock);
+    retired = std::move(m_retired_queue);
+    m_pending_queue = decode_queue;
+    m_switch_pending.store(true, std::memory_order_release);
+  }
+  if (retired) {
+    retired->stop();
+  }
+}
+
+void DecodeDataSource::seek(int64_t time_ms, bool keep_filter) {
+  auto decode_queue = current_queue();
+  m_keep_filter.store(keep_filter);
+  decode_queue->seek(time_ms);
+}
+
+void DecodeDataSource::seekFrame(int64_t frame, bool keep_filter) {
+  auto decode_queue = current_queue();
+  m_keep_filter.store(keep_filter);
+  decode_queue->seekFrame(frame);
+}
+
+std::shared_ptr<DecodeQueue> DecodeDataSource::current_queue() const {
+  std::lock_guard<SpinLock> lock(m_queue_lock);
+  return m_decode_queue;
+}
+
+// 读线程执行：只交换指针并通知旧队列退出，不 join、不释放
+void DecodeDataSource::swap_queue() {
+  std::lock_guard<SpinLock> lock(m_queue_lock);
+  m_switch_pending.store(false);
+  if (!m_pending_queue) {
+    return;
+  }
+  m_decode_queue->abort();
+  m_retired_queue = std::move(m_decode_queue);
+  m_decode_queue = std::move(m_pending_queue);
+  m_flush_serial = m_decode_queue->flushSerial();
+  // 上一曲残留在滤镜中的采样不能混进新曲目
+  resetFilter();
+}
+
+void DecodeDataSource::collect_retired_queue() {
+  std::shared_ptr<DecodeQueue> retired;
+  {
+    std::lock_guard<SpinLock> lock(m_queue_lock);
+    retired = std::move(m_retired_queue);
+  }
+  if (retired) {
+    retired->stop();
+  }
+}
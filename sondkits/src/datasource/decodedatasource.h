@@ -1,8 +1,10 @@
 
 #pragma once
 #include "audiofilter.h"
+#include "common.h"
 #include "datasource.h"
 #include "decodequeue.h"
+#include <atomic>
 #include <memory>
 
 class DecodeDataSource : public DataSource {
@@ -15,10 +17,36 @@ public:
   void close() override;
   bool isEnd() const override;
   int64_t bytesAvailable() const override;
+  // 在控制线程调用：读线程下一次读取时切换到已预读的队列，输出设备不停止
+  void switchQueue(std::shared_ptr<DecodeQueue> decode_queue);
+  // 在控制线程调用：seek 当前队列；keep_filter 为 true 时读端拿到新位置的
+  // 数据后不重置滤镜，用于从其他来源无缝接回解码流
+  void seek(int64_t time_ms, bool keep_filter = false);
+  // 按帧数 seek，精确到采样
+  void seekFrame(int64_t frame, bool keep_filter = false);
 
 protected:
   int64_t realReadData(uint8_t *data, int64_t size) override;
+  // 直接返回解码队列环形缓冲区内的数据，滤镜在上面原地处理
+  PCMSpan realAcquireRead(int64_t max_size, bool *writable) override;
+  void realCommitRead(int64_t size) override;
+
+private:
+  std::shared_ptr<DecodeQueue> current_queue() const;
+  void swap_queue();
+  void check_flush_serial();
+  void collect_retired_queue();
 
 private:
   std::shared_ptr<DecodeQueue> m_decode_queue;
+  int64_t m_flush_serial;
+  // 下一次冲刷不重置滤镜
+  std::atomic<bool> m_keep_filter;
+
+  // switch
+  mutable SpinLock m_queue_lock;
+  std::atomic<bool> m_switch_pending;
+  std::shared_ptr<DecodeQueue> m_pending_queue;
+  // 读线程换下的旧队列，由控制线程回收线程，避免在音频回调里 join
+  std::shared_ptr<DecodeQueue> m_retired_queue;
 };
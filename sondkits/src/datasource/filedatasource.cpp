@@ -1,22 +1,97 @@
 #include "filedatasource.h"
 #include <QDebug>
-#include <QFile>
 #include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// 预读窗口，读到窗口一半时提示下一个窗口
+static const int64_t kReadaheadSize = 4 * 1024 * 1024;
+// 读位置之后保留一个窗口再回收，回读和滤镜延迟不会触发缺页
+static const int64_t kReleaseLag = kReadaheadSize;
 
 FileDataSource::FileDataSource(std::shared_ptr<AudioFilter> audio_filter,
-                               int64_t frame_size, const std::string &file_path)
-    : DataSource(audio_filter, frame_size), m_file(file_path.c_str()) {}
+                               int64_t frame_size,
+                               const std::filesystem::path &file_path)
+    : DataSource(audio_filter, frame_size), m_file_path(file_path), m_pos(0),
+      m_readahead_end(0), m_released_end(0) {}
 
 int64_t FileDataSource::realReadData(uint8_t *data, int64_t maxlen) {
-  return m_file.read(reinterpret_cast<char *>(data), maxlen);
+  if (!m_file || !data || maxlen <= 0) {
+    return 0;
+  }
+  auto len = std::min(maxlen, m_file->size() - m_pos);
+  if (len <= 0) {
+    return 0;
+  }
+  memcpy(data, m_file->data() + m_pos, len);
+  m_pos += len;
+  advise_window();
+  return len;
+}
+
+PCMSpan FileDataSource::realAcquireRead(int64_t max_size, bool *writable) {
+  *writable = false;
+  return span(m_pos, max_size);
+}
+
+void FileDataSource::realCommitRead(int64_t size) {
+  if (!m_file || size <= 0) {
+    return;
+  }
+  m_pos = std::min(m_pos + size, m_file->size());
+  advise_window();
+}
+
+void FileDataSource::advise_window() {
+  if (m_pos + kReadaheadSize / 2 >= m_readahead_end) {
+    m_readahead_end = std::max(m_readahead_end, m_pos);
+    m_file->willNeed(m_readahead_end, kReadaheadSize);
+    m_readahead_end += kReadaheadSize;
+  }
+  if (m_pos - kReleaseLag - m_released_end >= kReadaheadSize) {
+    m_file->dontNeed(m_released_end, m_pos - kReleaseLag - m_released_end);
+    m_released_end = m_pos - kReleaseLag;
+  }
 }
 
-bool FileDataSource::isEnd() const { return m_file.atEnd(); }
+bool FileDataSource::isEnd() const {
+  return !m_file || m_pos >= m_file->size();
+}
 
 int64_t FileDataSource::bytesAvailable() const {
-  return m_file.bytesAvailable();
+  return m_file ? m_file->size() - m_pos : 0;
 }
 
-void FileDataSource::open() { m_file.open(QIODevice::ReadOnly); }
+int64_t FileDataSource::size() const { return m_file ? m_file->size() : 0; }
+
+int64_t FileDataSource::position() const { return m_pos; }
+
+PCMSpan FileDataSource::span(int64_t offset, int64_t size) const {
+  PCMSpan span;
+  if (!m_file || offset < 0 || offset >= m_file->size() || size <= 0) {
+    return span;
+  }
+  span.data = m_file->data() + offset;
+  span.size = std::min(size, m_file->size() - offset);
+  return span;
+}
 
-void FileDataSource::close() { m_file.close(); }
+void FileDataSource::open() {
+  close();
+  try {
+    m_file = std::make_unique<MappedFile>(m_file_path);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return;
+  }
+  m_file->adviseAccess(MappedFile::Access::Sequential);
+  advise_window();
+}
+
+void FileDataSource::close() {
+  m_file.reset();
+  m_pos = 0;
+  m_readahead_end = 0;
+  m_released_end = 0;
+}
@@ -1,23 +1,43 @@
-
 #pragma once
 #include "audiofilter.h"
 #include "datasource.h"
-#include <QFile>
+#include "mappedfile.h"
+#include <filesystem>
 #include <memory>
 
+// 原始 PCM 文件的数据源，整文件只读映射，偏移和长度都是 64 位
+// 顺序读取时提前预读后面的窗口，并回收已经读过的页，
+// 播放数小时的分轨也不会长期占用页缓存
 class FileDataSource : public DataSource {
 public:
   FileDataSource(std::shared_ptr<AudioFilter> audio_filter, int64_t frame_size,
-                 const std::string &file_path);
+                 const std::filesystem::path &file_path);
 
   void open() override;
   void close() override;
   bool isEnd() const override;
   int64_t bytesAvailable() const override;
 
+  int64_t size() const;
+  int64_t position() const;
+  // 从 offset 起最多 size 字节的映射视图，open 之后、close 之前有效
+  PCMSpan span(int64_t offset, int64_t size) const;
+
 protected:
   int64_t realReadData(uint8_t *data, int64_t size) override;
+  // 只读视图，有滤镜时由基类拷贝后再处理
+  PCMSpan realAcquireRead(int64_t max_size, bool *writable) override;
+  void realCommitRead(int64_t size) override;
+
+private:
+  void advise_window();
 
 private:
-  QFile m_file;
+  const std::filesystem::path m_file_path;
+  std::unique_ptr<MappedFile> m_file;
+  int64_t m_pos;
+  // 已经提示预读到的位置
+  int64_t m_readahead_end;
+  // 之前的页已经允许回收
+  int64_t m_released_end;
 };
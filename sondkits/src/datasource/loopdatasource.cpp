@@ -0,0 +1,244 @@
+#include "loopdatasource.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+// 接缝交叉淡化的时长，足够消除跳变又听不出重叠
+static constexpr int64_t kLoopCrossfadeMs = 5;
+
+// 线性交叉淡化：out = tail * (1 - w) + head * w，w 从接近 0 升到 1
+template <typename T>
+static void crossfade(T *out, const T *tail, const T *head, int64_t frames,
+                      int channels) {
+  for (int64_t i = 0; i < frames; i++) {
+    auto w = (double)(i + 1) / frames;
+    for (int c = 0; c < channels; c++) {
+      auto k = i * channels + c;
+      auto v = tail[k] * (1.0 - w) + head[k] * w;
+      if constexpr (std::is_integral_v<T>) {
+        out[k] = (T)std::llround(v);
+      } else {
+        out[k] = (T)v;
+      }
+    }
+  }
+}
+
+static bool crossfade(AVSampleFormat format, uint8_t *out, const uint8_t *tail,
+                      const uint8_t *head, int64_t frames, int channels) {
+  switch (format) {
+  case AV_SAMPLE_FMT_U8:
+    crossfade(out, tail, head, frames, channels);
+    return true;
+  case AV_SAMPLE_FMT_S16:
+    crossfade(reinterpret_cast<int16_t *>(out),
+              reinterpret_cast<const int16_t *>(tail),
+              reinterpret_cast<const int16_t *>(head), frames, channels);
+    return true;
+  case AV_SAMPLE_FMT_S32:
+    crossfade(reinterpret_cast<int32_t *>(out),
+              reinterpret_cast<const int32_t *>(tail),
+              reinterpret_cast<const int32_t *>(head), frames, channels);
+    return true;
+  case AV_SAMPLE_FMT_FLT:
+    crossfade(reinterpret_cast<float *>(out),
+              reinterpret_cast<const float *>(tail),
+              reinterpret_cast<const float *>(head), frames, channels);
+    return true;
+  case AV_SAMPLE_FMT_DBL:
+    crossfade(reinterpret_cast<double *>(out),
+              reinterpret_cast<const double *>(tail),
+              reinterpret_cast<const double *>(head), frames, channels);
+    return true;
+  default:
+    return false;
+  }
+}
+
+LoopDataSource::LoopDataSource(std::shared_ptr<AudioFilter> audio_filter,
+                               int64_t frame_size,
+                               std::shared_ptr<DecodeQueue> decode_queue)
+    : DecodeDataSource(audio_filter, frame_size, decode_queue),
+      m_frame_size(frame_size), m_loop_pos(0), m_exiting(false),
+      m_loop_pending(false), m_exit_requested(false), m_active(false) {}
+
+bool LoopDataSource::setLoop(std::shared_ptr<const PCMTrack> pcm,
+                             int64_t pcm_start_frame, int64_t a_frame,
+                             int64_t b_frame) {
+  if (!pcm || pcm->frameSize() != m_frame_size || a_frame >= b_frame ||
+      a_frame < pcm_start_frame) {
+    return false;
+  }
+  auto pcm_frames = pcm->size() / m_frame_size;
+  if (b_frame > pcm_start_frame + pcm_frames) {
+    return false;
+  }
+  auto loop = std::make_shared<Loop>();
+  loop->pcm = pcm;
+  loop->start_frame = pcm_start_frame;
+  loop->begin = (a_frame - pcm_start_frame) * m_frame_size;
+  loop->end = (b_frame - pcm_start_frame) * m_frame_size;
+
+  // 淡化长度受 A 之前可用的数据和循环长度限制，A 之前没有数据时不淡化
+  int64_t fade_frames = pcm->sampleRate() * kLoopCrossfadeMs / 1000;
+  fade_frames = std::min(fade_frames, (b_frame - a_frame) / 2);
+  fade_frames = std::min(fade_frames, a_frame - pcm_start_frame);
+  auto fade_size = fade_frames * m_frame_size;
+  loop->seam_begin = loop->end - fade_size;
+  if (fade_size > 0) {
+    loop->seam.resize(fade_size);
+    if (!crossfade(pcm->format(), loop->seam.data(),
+                   pcm->data() + loop->seam_begin,
+                   pcm->data() + loop->begin - fade_size, fade_frames,
+                   pcm->channels())) {
+      loop->seam_begin = loop->end;
+      loop->seam.clear();
+    }
+  }
+
+  m_exit_requested.store(false);
+  publish(loop);
+  // 解码流按帧提前定位到 B，退出循环时直接接上，不重置滤镜
+  seekFrame(b_frame, true);
+  return true;
+}
+
+void LoopDataSource::exitLoop() { m_exit_requested.store(true); }
+
+void LoopDataSource::clearLoop() { publish(nullptr); }
+
+void LoopDataSource::close() {
+  {
+    std::lock_guard<SpinLock> lock(m_loop_lock);
+    m_loop_pending.store(false);
+    m_pending_loop.reset();
+  }
+  collect_retired_loop();
+  DecodeDataSource::close();
+}
+
+bool LoopDataSource::isEnd() const {
+  if (m_active.load()) {
+    return false;
+  }
+  return DecodeDataSource::isEnd();
+}
+
+bool LoopDataSource::looping() const {
+  return m_active.load() || m_loop_pending.load();
+}
+
+// 回收与设置在同一临界区内，保证读线程换下旧循环时回收槽为空
+void LoopDataSource::publish(std::shared_ptr<Loop> loop) {
+  std::shared_ptr<Loop> retired;
+  std::shared_ptr<Loop> replaced;
+  {
+    std::lock_guard<SpinLock> lock(m_loop_lock);
+    retired = std::move(m_retired_loop);
+    replaced = std::move(m_pending_loop);
+    m_pending_loop = std::move(loop);
+    m_loop_pending.store(true, std::memory_order_release);
+  }
+}
+
+void LoopDataSource::collect_retired_loop() {
+  std::shared_ptr<Loop> retired;
+  std::lock_guard<SpinLock> lock(m_loop_lock);
+  retired = std::move(m_retired_loop);
+}
+
+// 读线程执行：只交换指针，旧循环由控制线程释放
+// 正在循环且当前位置落在新区间内时原位置继续，否则从 A 开始
+void LoopDataSource::apply_pending() {
+  std::lock_guard<SpinLock> lock(m_loop_lock);
+  m_loop_pending.store(false);
+  auto loop = std::move(m_pending_loop);
+  int64_t pos = -1;
+  if (loop && m_active.load()) {
+    auto frame = m_loop->start_frame + m_loop_pos / m_frame_size;
+    auto start = loop->start_frame + loop->begin / m_frame_size;
+    auto stop = loop->start_frame + loop->end / m_frame_size;
+    if (frame >= start && frame < stop) {
+      pos = (frame - loop->start_frame) * m_frame_size;
+    }
+  }
+  m_retired_loop = std::move(m_loop);
+  m_loop = std::move(loop);
+  m_exiting = false;
+  m_active.store(m_loop != nullptr);
+  if (m_loop) {
+    m_loop_pos = pos >= 0 ? pos : m_loop->begin;
+  }
+}
+
+// 循环内只做内存拷贝；接缝之前才接受退出请求，已进入接缝时要先回到 A
+int64_t LoopDataSource::read_loop(uint8_t *data, int64_t size) {
+  auto &loop = *m_loop;
+  auto pcm = loop.pcm->data();
+  int64_t readed = 0;
+  while (readed < size) {
+    if (!m_exiting && m_loop_pos < loop.seam_begin &&
+        m_exit_requested.exchange(false)) {
+      m_exiting = true;
+    }
+    if (m_loop_pos >= loop.end) {
+      if (m_exiting) {
+        break;
+      }
+      m_loop_pos = loop.begin;
+      continue;
+    }
+    const uint8_t *src = nullptr;
+    int64_t limit = 0;
+    if (m_exiting || m_loop_pos < loop.seam_begin) {
+      src = pcm + m_loop_pos;
+      limit = m_exiting ? loop.end : loop.seam_begin;
+    } else {
+      src = loop.seam.data() + (m_loop_pos - loop.seam_begin);
+      limit = loop.end;
+    }
+    auto len = std::min(limit - m_loop_pos, size - readed);
+    memcpy(data + readed, src, len);
+    readed += len;
+    m_loop_pos += len;
+  }
+  return readed;
+}
+
+int64_t LoopDataSource::realReadData(uint8_t *data, int64_t maxlen) {
+  if (!data || maxlen <= 0) {
+    return 0;
+  }
+  if (m_loop_pending.load(std::memory_order_acquire)) {
+    apply_pending();
+  }
+  if (!m_active.load(std::memory_order_relaxed)) {
+    return DecodeDataSource::realReadData(data, maxlen);
+  }
+  auto readed = read_loop(data, maxlen);
+  if (m_exiting && m_loop_pos >= m_loop->end) {
+    // 播放到 B，剩余部分在同一次读取里从解码流补齐；循环数据留到下次
+    // setLoop/clearLoop 时由控制线程释放
+    m_active.store(false);
+    m_exiting = false;
+    if (readed < maxlen) {
+      auto r = DecodeDataSource::realReadData(data + readed, maxlen - readed);
+      if (r > 0) {
+        readed += r;
+      }
+    }
+  }
+  return readed;
+}
+
+// 循环数据只读且可能有待切换的循环，改走拷贝路径
+PCMSpan LoopDataSource::realAcquireRead(int64_t max_size, bool *writable) {
+  if (m_loop_pending.load(std::memory_order_acquire) || m_active.load()) {
+    return {};
+  }
+  return DecodeDataSource::realAcquireRead(max_size, writable);
+}
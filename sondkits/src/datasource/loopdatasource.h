@@ -0,0 +1,67 @@
+#pragma once
+#include "decodedatasource.h"
+#include "pcmcache.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// A-B 循环：在解码流之上按采样精确地循环播放内存中的 [A,B)，
+// 循环期间只做内存拷贝，不 seek、不解码
+// 接缝处 B 之前的一小段与 A 之前的一小段预先交叉淡化，回到 A 时波形连续；
+// 退出循环时播放原始的 B 之前的数据，到 B 后接回已经提前定位到 B 的解码流
+class LoopDataSource : public DecodeDataSource {
+public:
+  LoopDataSource(std::shared_ptr<AudioFilter> audio_filter, int64_t frame_size,
+                 std::shared_ptr<DecodeQueue> decode_queue);
+
+  void close() override;
+  bool isEnd() const override;
+
+  // 在控制线程调用，下一次读取生效：
+  // pcm 从 pcm_start_frame 开始，至少覆盖 [a_frame, b_frame)，
+  // 覆盖到 A 之前时用于接缝淡化；同时把解码流定位到 B
+  // 当前播放位置在新区间内时从原位置继续，否则从 A 开始
+  bool setLoop(std::shared_ptr<const PCMTrack> pcm, int64_t pcm_start_frame,
+               int64_t a_frame, int64_t b_frame);
+  // 播放到 B 后接回解码流
+  void exitLoop();
+  // 立即停止循环(如用户 seek)，之后需要 seek 解码流
+  void clearLoop();
+  bool looping() const;
+
+protected:
+  int64_t realReadData(uint8_t *data, int64_t size) override;
+  PCMSpan realAcquireRead(int64_t max_size, bool *writable) override;
+
+private:
+  struct Loop {
+    std::shared_ptr<const PCMTrack> pcm;
+    int64_t start_frame;
+    // A、B 和接缝在 pcm 中的字节偏移
+    int64_t begin;
+    int64_t end;
+    int64_t seam_begin;
+    // 交叉淡化后的接缝，替换 [seam_begin, end)
+    std::vector<uint8_t> seam;
+  };
+
+  void apply_pending();
+  int64_t read_loop(uint8_t *data, int64_t size);
+  void publish(std::shared_ptr<Loop> loop);
+  void collect_retired_loop();
+
+private:
+  const int64_t m_frame_size;
+  // 读线程状态
+  std::shared_ptr<Loop> m_loop;
+  int64_t m_loop_pos;
+  bool m_exiting;
+
+  mutable SpinLock m_loop_lock;
+  std::atomic<bool> m_loop_pending;
+  std::shared_ptr<Loop> m_pending_loop;
+  // 读线程换下的循环，由控制线程释放
+  std::shared_ptr<Loop> m_retired_loop;
+  std::atomic<bool> m_exit_requested;
+  std::atomic<bool> m_active;
+};
@@ -2,10 +2,12 @@
 #include <QDebug>
 #include <QFile>
 #include <QtGlobal>
+#include <algorithm>
 #include <cstring>
 
 MemoryDataSource::MemoryDataSource(std::shared_ptr<AudioFilter> audio_filter,
-                                   int64_t frame_size, char *data, int size)
+                                   int64_t frame_size, const char *data,
+                                   int64_t size)
     : DataSource(audio_filter, frame_size), m_data(data), m_size(size),
       m_pos(0) {}
 
@@ -16,16 +18,42 @@ int64_t MemoryDataSource::realReadData(uint8_t *data, int64_t maxlen) {
   if (m_size <= m_pos) {
     return -1;
   }
-  auto len = std::min(static_cast<int>(maxlen), m_size - m_pos);
+  auto len = std::min(maxlen, m_size - m_pos);
   memcpy(data, m_data + m_pos, len);
   m_pos += len;
   return len;
 }
 
+PCMSpan MemoryDataSource::realAcquireRead(int64_t max_size, bool *writable) {
+  *writable = false;
+  return span(m_pos, max_size);
+}
+
+void MemoryDataSource::realCommitRead(int64_t size) {
+  if (size > 0) {
+    m_pos = std::min(m_pos + size, m_size);
+  }
+}
+
 bool MemoryDataSource::isEnd() const { return m_pos >= m_size; }
 
 int64_t MemoryDataSource::bytesAvailable() const { return m_size - m_pos; }
 
+int64_t MemoryDataSource::size() const { return m_size; }
+
+int64_t MemoryDataSource::position() const { return m_pos; }
+
+PCMSpan MemoryDataSource::span(int64_t offset, int64_t size) const {
+  PCMSpan span;
+  if (offset < 0 || offset >= m_size || size <= 0) {
+    return span;
+  }
+  span.data = reinterpret_cast<const uint8_t *>(m_data) + offset;
+  span.size = std::min(size, m_size - offset);
+  return span;
+}
+
 void MemoryDataSource::open() { m_pos = 0; }
 
 void MemoryDataSource::close() { m_pos = 0; }
+
@@ -1,4 +1,3 @@
-
 #pragma once
 #include "audiofilter.h"
 #include "datasource.h"
@@ -6,19 +5,28 @@
 
 class MemoryDataSource : public DataSource {
 public:
+  // data 由调用方持有，在数据源关闭前保持有效
   MemoryDataSource(std::shared_ptr<AudioFilter> audio_filter,
-                   int64_t frame_size, char *data, int size);
+                   int64_t frame_size, const char *data, int64_t size);
 
   void open() override;
   void close() override;
   bool isEnd() const override;
   int64_t bytesAvailable() const override;
 
+  int64_t size() const;
+  int64_t position() const;
+  // 从 offset 起最多 size 字节的视图，越界部分截断
+  PCMSpan span(int64_t offset, int64_t size) const;
+
 protected:
   int64_t realReadData(uint8_t *data, int64_t size) override;
+  // 只读视图，有滤镜时由基类拷贝后再处理
+  PCMSpan realAcquireRead(int64_t max_size, bool *writable) override;
+  void realCommitRead(int64_t size) override;
 
 private:
-  char *m_data;
-  int m_size;
-  int m_pos;
-};
\ No newline at end of file
+  const char *m_data;
+  int64_t m_size;
+  int64_t m_pos;
+};
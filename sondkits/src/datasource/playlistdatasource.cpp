@@ -0,0 +1,214 @@
+#include "playlistdatasource.h"
+#include <QDebug>
+#include <QtGlobal>
+
+PlaylistDataSource::PlaylistDataSource(
+    std::shared_ptr<AudioFilter> audio_filter, int64_t frame_size)
+    : DataSource(audio_filter, frame_size), m_flush_serial(0), m_index(-1),
+      m_opened(false), m_worker_signaled(false), m_worker_waiting(false),
+      m_worker_stop(false) {
+  // 读线程换曲时不扩容
+  m_retired.reserve(16);
+}
+
+PlaylistDataSource::~PlaylistDataSource() { close(); }
+
+void PlaylistDataSource::open() {
+  std::shared_ptr<DecodeQueue> first;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    if (m_opened) {
+      return;
+    }
+    m_opened = true;
+    if (!m_pending.empty()) {
+      first = m_pending.front();
+    }
+  }
+  m_worker_stop = false;
+  m_worker = std::thread(&PlaylistDataSource::worker_loop, this);
+  if (first) {
+    first->start();
+  }
+  // 第一曲由读线程在第一次读取时换入，之后后台线程启动第二曲
+  notify_worker();
+}
+
+void PlaylistDataSource::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_worker_mutex);
+    m_worker_stop = true;
+    m_worker_cv.notify_all();
+  }
+  if (m_worker.joinable()) {
+    m_worker.join();
+  }
+  std::shared_ptr<DecodeQueue> current;
+  std::deque<std::shared_ptr<DecodeQueue>> pending;
+  std::vector<std::shared_ptr<DecodeQueue>> retired;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    m_opened = false;
+    current = std::move(m_current);
+    pending.swap(m_pending);
+    retired.swap(m_retired);
+  }
+  if (current) {
+    current->stop();
+  }
+  for (auto &queue : pending) {
+    queue->stop();
+  }
+  for (auto &queue : retired) {
+    queue->stop();
+  }
+}
+
+bool PlaylistDataSource::isEnd() const {
+  std::lock_guard<SpinLock> lock(m_lock);
+  if (!m_pending.empty()) {
+    return false;
+  }
+  return !m_current || m_current->canRead();
+}
+
+int64_t PlaylistDataSource::bytesAvailable() const {
+  std::lock_guard<SpinLock> lock(m_lock);
+  int64_t bytes = m_current ? m_current->bytesAvailable() : 0;
+  if (!m_pending.empty()) {
+    bytes += m_pending.front()->bytesAvailable();
+  }
+  return bytes;
+}
+
+void PlaylistDataSource::append(std::shared_ptr<DecodeQueue> decode_queue) {
+  if (!decode_queue) {
+    return;
+  }
+  bool start = false;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    m_pending.push_back(decode_queue);
+    // 成为下一曲时立即开始预解码
+    start = m_opened && m_pending.size() == 1;
+  }
+  if (start) {
+    decode_queue->start();
+  }
+}
+
+void PlaylistDataSource::seek(int64_t time_ms) {
+  std::shared_ptr<DecodeQueue> current;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    current = m_current;
+  }
+  if (current) {
+    current->seek(time_ms);
+  }
+}
+
+int PlaylistDataSource::currentIndex() const { return m_index.load(); }
+
+// 当前曲目读空且已结束时在同一次读取里接上下一曲；
+// 当前曲目仍在解码时只返回已读到的部分，不在这里阻塞
+int64_t PlaylistDataSource::realReadData(uint8_t *data, int64_t maxlen) {
+  if (!data || maxlen <= 0) {
+    return 0;
+  }
+  if (!m_current && !advance()) {
+    return 0;
+  }
+  int64_t readed = 0;
+  while (readed < maxlen) {
+    auto r = m_current->readData(data + readed, maxlen - readed);
+    check_flush_serial();
+    if (r > 0) {
+      readed += r;
+    }
+    if (readed >= maxlen || !m_current->canRead()) {
+      break;
+    }
+    if (!advance()) {
+      break;
+    }
+  }
+  return readed;
+}
+
+bool PlaylistDataSource::advance() {
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    if (m_pending.empty()) {
+      return false;
+    }
+    if (m_current) {
+      m_current->abort();
+      m_retired.push_back(std::move(m_current));
+    }
+    m_current = std::move(m_pending.front());
+    m_pending.pop_front();
+    m_flush_serial = m_current->flushSerial();
+  }
+  m_index.fetch_add(1);
+  notify_worker();
+  return true;
+}
+
+// 曲目内 seek 丢弃了旧数据，滤镜中残留的旧采样也要一起丢弃
+void PlaylistDataSource::check_flush_serial() {
+  auto serial = m_current->flushSerial();
+  if (serial != m_flush_serial) {
+    m_flush_serial = serial;
+    resetFilter();
+  }
+}
+
+// 只有后台线程确实在等待时才短暂获取互斥量
+void PlaylistDataSource::notify_worker() {
+  m_worker_signaled.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_worker_waiting.load()) {
+    std::lock_guard<std::mutex> lock(m_worker_mutex);
+    m_worker_cv.notify_one();
+  }
+}
+
+void PlaylistDataSource::worker_loop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_worker_mutex);
+      m_worker_waiting.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      m_worker_cv.wait(lock, [this]() -> bool {
+        return m_worker_stop || m_worker_signaled.load();
+      });
+      m_worker_waiting.store(false);
+      if (m_worker_stop) {
+        break;
+      }
+      m_worker_signaled.store(false);
+    }
+    maintain();
+  }
+}
+
+void PlaylistDataSource::maintain() {
+  std::shared_ptr<DecodeQueue> next;
+  std::vector<std::shared_ptr<DecodeQueue>> retired;
+  {
+    std::lock_guard<SpinLock> lock(m_lock);
+    if (!m_pending.empty()) {
+      next = m_pending.front();
+    }
+    retired.reserve(m_retired.capacity());
+    retired.swap(m_retired);
+  }
+  // start 可重复调用，已启动的队列不受影响
+  if (next) {
+    next->start();
+  }
+  for (auto &queue : retired) {
+    queue->stop();
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "audiofilter.h"
+#include "common.h"
+#include "datasource.h"
+#include "decodequeue.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 无缝播放列表：依次播放多个解码队列，上一曲最后一个采样之后紧接下一曲的
+// 第一个采样，同一次读取里就能跨过曲目边界；输出设备和滤镜只有一份，
+// 曲目之间不重置滤镜
+// 当前曲目播放时下一曲的队列已经在解码，线程的启动和回收由后台线程完成，
+// 读线程上只交换指针
+// 所有曲目的输出格式必须一致
+class PlaylistDataSource : public DataSource {
+public:
+  PlaylistDataSource(std::shared_ptr<AudioFilter> audio_filter,
+                     int64_t frame_size);
+  ~PlaylistDataSource() override;
+
+  void open() override;
+  void close() override;
+  bool isEnd() const override;
+  int64_t bytesAvailable() const override;
+
+  // 在控制线程调用：把未启动的队列追加到列表末尾
+  void append(std::shared_ptr<DecodeQueue> decode_queue);
+  // 在当前曲目内 seek
+  void seek(int64_t time_ms);
+  // 当前曲目的序号，还没有开始播放时为 -1
+  int currentIndex() const;
+
+protected:
+  int64_t realReadData(uint8_t *data, int64_t size) override;
+
+private:
+  // 读线程执行：换到下一曲，没有下一曲时返回 false
+  bool advance();
+  void check_flush_serial();
+  void notify_worker();
+  void worker_loop();
+  // 启动下一曲、回收已播完的队列
+  void maintain();
+
+private:
+  std::shared_ptr<DecodeQueue> m_current;
+  int64_t m_flush_serial;
+  std::atomic<int> m_index;
+
+  // 保护 m_current 的替换以及待播、待回收列表
+  mutable SpinLock m_lock;
+  std::deque<std::shared_ptr<DecodeQueue>> m_pending;
+  std::vector<std::shared_ptr<DecodeQueue>> m_retired;
+  bool m_opened;
+
+  // worker
+  std::thread m_worker;
+  std::mutex m_worker_mutex;
+  std::condition_variable m_worker_cv;
+  std::atomic<bool> m_worker_signaled;
+  std::atomic<bool> m_worker_waiting;
+  bool m_worker_stop;
+};
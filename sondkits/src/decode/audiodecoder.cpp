@@ -1,6 +1,8 @@
 #include "audiodecoder.h"
 #include "common.h"
-#include <cassert>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 extern "C" {
@@ -9,36 +11,200 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+// swresample 支持的最大声道数
+static constexpr int kMaxChannels = 64;
+// 自定义 IO 的读缓冲大小
+static constexpr int kIOBufferSize = 64 * 1024;
+// 快速打开的探测上限：64KB 数据 / 200ms 时长
+static constexpr int64_t kFastProbeSize = 64 * 1024;
+static constexpr int64_t kFastAnalyzeDuration = AV_TIME_BASE / 5;
+// seek 时从目标之前多解这么久(ms)预热解码器(MP3 比特池、AAC/Vorbis 重叠)
+static constexpr int64_t kSeekPrerollMs = 200;
+
 AudioDecoder::AudioDecoder(int target_sample_rate, int target_channels,
                            AVSampleFormat target_sample_format)
-    : m_fmt_ctx(nullptr), m_dec_ctx(nullptr), m_in_astream_idx(-1),
+    : m_fmt_ctx(nullptr), m_dec_ctx(nullptr), m_swr_ctx(nullptr),
+      m_packet(nullptr), m_frame(nullptr), m_avio_ctx(nullptr), m_io_pos(0),
+      m_fast_open(false), m_in_astream_idx(-1), m_start_pts(0),
+      m_next_sample_pos(0), m_seek_target_sample(-1), m_end_sample(-1),
+      m_priming_samples(0), m_gapless_end_sample(-1),
+      m_ignore_timestamps(false), m_build_seek_index(false),
+      m_seek_index_loaded(false), m_seek_index_pass(false),
       m_target_sample_rate(target_sample_rate),
-      m_target_channels(target_channels),
+      m_target_channels(target_channels), m_target_sample_size(0),
       m_target_sample_format(target_sample_format), m_is_end(false),
-      m_packet(nullptr), m_frame(nullptr) {
-  assert(av_sample_fmt_is_planar(target_sample_format) == 0);
+      m_reached_track_end(false) {
+  if (av_sample_fmt_is_planar(target_sample_format) &&
+      target_channels > kMaxChannels) {
+    throw std::runtime_error("Too many channels for planar output");
+  }
 }
 
 AudioDecoder::~AudioDecoder() { close(); }
 
 void AudioDecoder::open(const std::filesystem::path &in_fpath) {
-  int ret = 0;
-  if ((ret = avformat_open_input(&m_fmt_ctx, in_fpath.u8string().c_str(),
-                                 nullptr, nullptr)) < 0) {
+  // 标准输入和管道走自定义 IO 的流式模式
+  if (StreamByteSource::isStreamPath(in_fpath)) {
+    open(std::make_shared<StreamByteSource>(in_fpath));
+    return;
+  }
+  // 命中探测缓存时直接指定输入格式，跳过格式探测
+  ProbeCache::Entry probe;
+  bool cached = ProbeCache::instance().find(in_fpath, &probe, !m_fast_open);
+  AVDictionary *options = probeOptions(false);
+  int ret = avformat_open_input(&m_fmt_ctx, in_fpath.u8string().c_str(),
+                                cached ? probe.iformat : nullptr, &options);
+  av_dict_free(&options);
+  if (ret < 0) {
     throw std::runtime_error("[avformat_open_input]Could not open input file:" +
                              avErr2String(ret));
   }
+  m_in_fpath = in_fpath;
+  openStream(cached ? &probe : nullptr);
+}
 
-  if ((ret = avformat_find_stream_info(m_fmt_ctx, nullptr)) < 0) {
-    throw std::runtime_error("[avformat_find_stream_info]Failed to retrieve "
-                             "input stream information");
+void AudioDecoder::open(std::shared_ptr<ByteSource> source) {
+  if (!source) {
+    throw std::runtime_error("Invalid byte source");
+  }
+  auto io_buffer = static_cast<uint8_t *>(av_malloc(kIOBufferSize));
+  if (!io_buffer) {
+    throw std::runtime_error("Failed to allocate io buffer");
   }
+  m_io_source = source;
+  m_io_pos = 0;
+  m_avio_ctx = avio_alloc_context(io_buffer, kIOBufferSize, 0, this,
+                                  &AudioDecoder::ioRead, nullptr,
+                                  source->seekable() ? &AudioDecoder::ioSeek
+                                                     : nullptr);
+  if (!m_avio_ctx) {
+    av_free(io_buffer);
+    throw std::runtime_error("Failed to allocate io context");
+  }
+  m_avio_ctx->seekable = source->seekable() ? AVIO_SEEKABLE_NORMAL : 0;
 
-  int stream_index =
-      av_find_best_stream(m_fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-  if (stream_index < 0) {
-    throw std::runtime_error(
-        "[av_find_best_stream]Could not find audio stream in the input file");
+  m_fmt_ctx = avformat_alloc_context();
+  if (!m_fmt_ctx) {
+    throw std::runtime_error("Failed to allocate format context");
+  }
+  m_fmt_ctx->pb = m_avio_ctx;
+  m_fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+  // 不可 seek 的输入无法回头重读，探测窗口必须受限
+  AVDictionary *options = probeOptions(!source->seekable());
+  // 打开失败时 avformat_open_input 会释放 m_fmt_ctx 并置空
+  int ret = avformat_open_input(&m_fmt_ctx, nullptr, nullptr, &options);
+  av_dict_free(&options);
+  if (ret < 0) {
+    throw std::runtime_error("[avformat_open_input]Could not open input:" +
+                             avErr2String(ret));
+  }
+  m_in_fpath.clear();
+  openStream(nullptr);
+}
+
+int AudioDecoder::ioRead(void *opaque, uint8_t *buf, int buf_size) {
+  auto self = static_cast<AudioDecoder *>(opaque);
+  auto r = self->m_io_source->readAt(self->m_io_pos, buf, buf_size);
+  if (r < 0) {
+    return AVERROR(EIO);
+  }
+  if (r == 0) {
+    return AVERROR_EOF;
+  }
+  self->m_io_pos += r;
+  return (int)r;
+}
+
+int64_t AudioDecoder::ioSeek(void *opaque, int64_t offset, int whence) {
+  auto self = static_cast<AudioDecoder *>(opaque);
+  auto size = self->m_io_source->size();
+  if (whence & AVSEEK_SIZE) {
+    return size >= 0 ? size : AVERROR(ENOSYS);
+  }
+  int64_t pos = 0;
+  switch (whence & ~AVSEEK_FORCE) {
+  case SEEK_SET:
+    pos = offset;
+    break;
+  case SEEK_CUR:
+    pos = self->m_io_pos + offset;
+    break;
+  case SEEK_END:
+    if (size < 0) {
+      return AVERROR(ENOSYS);
+    }
+    pos = size + offset;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+  if (pos < 0) {
+    return AVERROR(EINVAL);
+  }
+  self->m_io_pos = pos;
+  return pos;
+}
+
+std::shared_ptr<ByteSource> AudioDecoder::byteSource() const {
+  return m_io_source;
+}
+
+void AudioDecoder::setFastOpen(bool fast_open) { m_fast_open = fast_open; }
+
+// 快速打开或流式输入时限制探测的数据量和时长，时长可能退化为按码率估算
+AVDictionary *AudioDecoder::probeOptions(bool streaming) const {
+  if (!m_fast_open && !streaming) {
+    return nullptr;
+  }
+  AVDictionary *options = nullptr;
+  av_dict_set_int(&options, "probesize", kFastProbeSize, 0);
+  av_dict_set_int(&options, "analyzeduration", kFastAnalyzeDuration, 0);
+  return options;
+}
+
+// 用缓存的探测结果代替 avformat_find_stream_info，流结构对不上时返回 false
+bool AudioDecoder::applyProbeResult(const ProbeCache::Entry &probe) {
+  if (probe.stream_index < 0 ||
+      probe.stream_index >= (int)m_fmt_ctx->nb_streams) {
+    return false;
+  }
+  AVStream *stream = m_fmt_ctx->streams[probe.stream_index];
+  if (stream->codecpar->codec_id != probe.codecpar->codec_id ||
+      avcodec_parameters_copy(stream->codecpar, probe.codecpar.get()) < 0) {
+    return false;
+  }
+  stream->time_base = probe.time_base;
+  stream->start_time = probe.start_time;
+  stream->duration = probe.stream_duration;
+  m_fmt_ctx->duration = probe.duration;
+  m_fmt_ctx->bit_rate = probe.bit_rate;
+  return true;
+}
+
+void AudioDecoder::openStream(const ProbeCache::Entry *probe) {
+  int ret = 0;
+  int stream_index = -1;
+  if (probe && applyProbeResult(*probe)) {
+    stream_index = probe->stream_index;
+  } else {
+    if ((ret = avformat_find_stream_info(m_fmt_ctx, nullptr)) < 0) {
+      throw std::runtime_error("[avformat_find_stream_info]Failed to retrieve "
+                               "input stream information");
+    }
+
+    stream_index =
+        av_find_best_stream(m_fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (stream_index < 0) {
+      throw std::runtime_error(
+          "[av_find_best_stream]Could not find audio stream in the input file");
+    }
+    // 参数不完整的探测结果不缓存，下次打开重新探测
+    auto par = m_fmt_ctx->streams[stream_index]->codecpar;
+    if (!m_in_fpath.empty() && par->sample_rate > 0 &&
+        par->ch_layout.nb_channels > 0) {
+      ProbeCache::instance().insert(m_in_fpath, m_fmt_ctx, stream_index,
+                                    !m_fast_open);
+    }
   }
 
   AVStream *audio_stream = m_fmt_ctx->streams[stream_index];
@@ -75,7 +241,19 @@ void AudioDecoder::open(const std::filesystem::path &in_fpath) {
   }
 
   m_in_astream_idx = stream_index;
+  m_start_pts = audio_stream->start_time != AV_NOPTS_VALUE
+                    ? audio_stream->start_time
+                    : 0;
+  m_next_sample_pos = 0;
+  m_seek_target_sample = -1;
+  m_ignore_timestamps = false;
   m_is_end = false;
+  m_reached_track_end = false;
+  applyGaplessInfo(audio_stream);
+  m_seek_index.clear();
+  m_seek_index_loaded = needSeekIndex() && m_seek_index.load(m_in_fpath);
+  m_seek_index_pass =
+      m_build_seek_index && needSeekIndex() && !m_seek_index_loaded;
   if (m_packet == nullptr) {
     m_packet = av_packet_alloc();
   }
@@ -84,17 +262,78 @@ void AudioDecoder::open(const std::filesystem::path &in_fpath) {
   }
 
   // 如果是完全满足要求的，则不需要重采样
-  if (m_target_channels <= 0 || m_target_sample_rate <= 0) {
-    m_swr_ctx = nullptr;
+  m_swr_ctx = nullptr;
+  if (m_target_channels > 0 && m_target_sample_rate > 0 &&
+      (m_dec_ctx->sample_rate != m_target_sample_rate ||
+       m_dec_ctx->ch_layout.nb_channels != m_target_channels ||
+       m_dec_ctx->sample_fmt != m_target_sample_format)) {
+    initSwr();
+  }
+  reserveBufferPool();
+}
+
+// FFmpeg 已经通过 AV_PKT_DATA_SKIP_SAMPLES 在解码时去掉 MP4 编辑列表、
+// LAME 头、Opus pre-skip 等声明的延迟和补齐。iTunes 编码的 MP3/ADTS AAC
+// 只在 iTunSMPB 标签里记录：" 00000000 00000840 000001CA 00000000003F31F6"，
+// 依次为保留、延迟、补齐、原始采样数(十六进制)，这里按它裁掉首尾
+void AudioDecoder::applyGaplessInfo(const AVStream *stream) {
+  m_priming_samples = 0;
+  m_gapless_end_sample = -1;
+  m_end_sample = -1;
+  auto name = m_fmt_ctx->iformat->name;
+  // start_time > 0 说明解复用器已经按 LAME 头处理过延迟
+  if ((strcmp(name, "mp3") != 0 && strcmp(name, "aac") != 0) ||
+      (stream->start_time != AV_NOPTS_VALUE && stream->start_time > 0)) {
     return;
   }
-  if (m_dec_ctx->sample_rate == m_target_sample_rate &&
-      m_dec_ctx->ch_layout.nb_channels == m_target_channels &&
-      m_dec_ctx->sample_fmt == m_target_sample_format) {
-    m_swr_ctx = nullptr;
+  const AVDictionaryEntry *tag =
+      av_dict_get(stream->metadata, "iTunSMPB", nullptr, 0);
+  if (!tag) {
+    tag = av_dict_get(m_fmt_ctx->metadata, "iTunSMPB", nullptr, 0);
+  }
+  unsigned long long reserved = 0, delay = 0, padding = 0, total = 0;
+  if (!tag || sscanf(tag->value, " %llx %llx %llx %llx", &reserved, &delay,
+                     &padding, &total) != 4) {
+    return;
+  }
+  m_priming_samples = static_cast<int64_t>(delay);
+  m_gapless_end_sample = total > 0 ? static_cast<int64_t>(total) : -1;
+  m_end_sample = m_gapless_end_sample;
+  if (m_priming_samples <= 0) {
     return;
   }
-  initSwr();
+  // 起点后移到延迟之后，之前的采样位置为负，按 seek 目标 0 丢弃
+  m_start_pts += av_rescale_q(m_priming_samples,
+                              AVRational{1, m_dec_ctx->sample_rate},
+                              stream->time_base);
+  m_next_sample_pos = -m_priming_samples;
+  m_seek_target_sample = 0;
+}
+
+int64_t AudioDecoder::primingSamples() const { return m_priming_samples; }
+
+// 按解码器的最大帧大小预分配缓冲池块大小，
+// frame_size 未知时由 acquire 在首帧按需调整
+void AudioDecoder::reserveBufferPool() {
+  int frame_samples = m_dec_ctx->frame_size;
+  if (frame_samples <= 0) {
+    return;
+  }
+  int64_t size = 0;
+  if (!m_swr_ctx) {
+    size = av_samples_get_buffer_size(nullptr, m_dec_ctx->ch_layout.nb_channels,
+                                      frame_samples, m_dec_ctx->sample_fmt, 1);
+  } else {
+    // 预留重采样器内部延迟的余量
+    int out_samples =
+        av_rescale_rnd(frame_samples + 256, m_target_sample_rate,
+                       m_dec_ctx->sample_rate, AV_ROUND_UP);
+    size = av_samples_get_buffer_size(nullptr, m_target_channels, out_samples,
+                                      m_target_sample_format, 1);
+  }
+  if (size > 0) {
+    m_buffer_pool.reserve(size);
+  }
 }
 
 AVFormatContext *AudioDecoder::fmtCtx() const { return m_fmt_ctx; }
@@ -103,10 +342,19 @@ AVCodecContext *AudioDecoder::codecCtx() const { return m_dec_ctx; }
 
 int AudioDecoder::audioStreamIndex() const { return m_in_astream_idx; }
 
+// 流式输入通常没有时长信息，返回 0
 double AudioDecoder::duration() const {
+  if (!m_fmt_ctx || m_fmt_ctx->duration == AV_NOPTS_VALUE) {
+    return 0;
+  }
   return double(m_fmt_ctx->duration) / AV_TIME_BASE;
 }
 
+bool AudioDecoder::seekable() const {
+  return m_fmt_ctx && m_fmt_ctx->pb &&
+         (m_fmt_ctx->pb->seekable & AVIO_SEEKABLE_NORMAL);
+}
+
 int AudioDecoder::targetSampleRate() const { return m_target_sample_rate; }
 
 int AudioDecoder::targetChannels() const { return m_target_channels; }
@@ -123,13 +371,109 @@ AVSampleFormat AudioDecoder::sampleFormat() const {
   return m_dec_ctx->sample_fmt;
 }
 
+int64_t AudioDecoder::bytesPerSecond() const {
+  if (!m_swr_ctx) {
+    if (!m_dec_ctx) {
+      return 0;
+    }
+    return int64_t(m_dec_ctx->sample_rate) * m_dec_ctx->ch_layout.nb_channels *
+           av_get_bytes_per_sample(m_dec_ctx->sample_fmt);
+  }
+  return int64_t(m_target_sample_rate) * m_target_channels *
+         av_get_bytes_per_sample(m_target_sample_format);
+}
+
+int AudioDecoder::planes() const {
+  if (!m_swr_ctx && m_dec_ctx) {
+    return av_sample_fmt_is_planar(m_dec_ctx->sample_fmt)
+               ? m_dec_ctx->ch_layout.nb_channels
+               : 1;
+  }
+  return av_sample_fmt_is_planar(m_target_sample_format) ? m_target_channels
+                                                         : 1;
+}
+
 bool AudioDecoder::isEnd() const { return m_is_end; }
 
-void AudioDecoder::freeData(uint8_t **data) {
-  if (!data || !*data) {
+bool AudioDecoder::reachedTrackEnd() const { return m_reached_track_end; }
+
+void AudioDecoder::setBuildSeekIndex(bool build) { m_build_seek_index = build; }
+
+void AudioDecoder::setEndPosition(int64_t time_ms) {
+  if (time_ms < 0 || !m_dec_ctx) {
+    m_end_sample = m_gapless_end_sample;
     return;
   }
-  av_freep(data);
+  m_end_sample = av_rescale(time_ms, m_dec_ctx->sample_rate, 1000);
+  if (m_gapless_end_sample >= 0) {
+    m_end_sample = std::min(m_end_sample, m_gapless_end_sample);
+  }
+}
+
+const std::filesystem::path &AudioDecoder::path() const { return m_in_fpath; }
+
+bool AudioDecoder::hasSeekIndex() const { return m_seek_index_loaded; }
+
+bool AudioDecoder::isBuildingSeekIndex() const { return m_seek_index_pass; }
+
+// 没有 TOC 的 VBR MP3 和裸 ADTS AAC 只能估算定位，需要包索引
+// 索引以旁路文件保存，只支持从文件路径打开的输入
+bool AudioDecoder::needSeekIndex() const {
+  if (!m_fmt_ctx || !m_fmt_ctx->iformat || m_in_fpath.empty()) {
+    return false;
+  }
+  auto name = m_fmt_ctx->iformat->name;
+  return strcmp(name, "mp3") == 0 || strcmp(name, "aac") == 0;
+}
+
+void AudioDecoder::recordSeekIndex(const AVPacket *packet) {
+  int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+  if (pts == AV_NOPTS_VALUE || packet->pos < 0) {
+    m_seek_index_pass = false;
+    m_seek_index.clear();
+    return;
+  }
+  // 每 250ms 记录一个包，索引保持紧凑
+  auto min_interval =
+      av_rescale_q(250, AVRational{1, 1000}, m_dec_ctx->pkt_timebase);
+  m_seek_index.add(pts, packet->pos, min_interval);
+}
+
+// 二分查找目标之前的包并直接按字节偏移跳转
+bool AudioDecoder::seekByIndex(int64_t target_pts) {
+  auto preroll = av_rescale_q(kSeekPrerollMs, AVRational{1, 1000},
+                              m_dec_ctx->pkt_timebase);
+  auto entry = m_seek_index.find(target_pts - preroll);
+  if (!entry) {
+    entry = m_seek_index.find(target_pts);
+  }
+  if (!entry) {
+    return false;
+  }
+  int ret = avformat_seek_file(m_fmt_ctx, -1, entry->pos, entry->pos,
+                               entry->pos, AVSEEK_FLAG_BYTE);
+  if (ret < 0) {
+    return false;
+  }
+  m_next_sample_pos =
+      av_rescale_q(entry->pts - m_start_pts, m_dec_ctx->pkt_timebase,
+                   AVRational{1, m_dec_ctx->sample_rate});
+  m_ignore_timestamps = true;
+  return true;
+}
+
+void AudioDecoder::freeData(FrameData &data) {
+  if (data.buf) {
+    av_buffer_unref(&data.buf);
+  } else if (data.data) {
+    m_buffer_pool.release(data.data);
+  }
+  data.data = nullptr;
+  data.size = 0;
+}
+
+int64_t AudioDecoder::bufferAllocations() const {
+  return m_buffer_pool.allocations();
 }
 
 void AudioDecoder::close() {
@@ -153,6 +497,12 @@ void AudioDecoder::close() {
     av_frame_free(&m_frame);
     m_frame = nullptr;
   }
+  // 自定义 IO 不会被 avformat_close_input 释放
+  if (m_avio_ctx) {
+    av_freep(&m_avio_ctx->buffer);
+    avio_context_free(&m_avio_ctx);
+  }
+  m_io_source.reset();
 }
 
 void AudioDecoder::initSwr() {
@@ -179,32 +529,50 @@ void AudioDecoder::initSwr() {
   m_swr_ctx = swr_ctx;
 }
 
-FrameDataList AudioDecoder::decodeNextFrameData() {
-  FrameDataList frame_data_list;
+FrameDataList &AudioDecoder::decodeNextFrameData() {
+  auto &frame_data_list = m_frame_data_list;
+  frame_data_list.clear();
+  if (m_is_end) {
+    return frame_data_list;
+  }
 
   while (true) {
     int ret = av_read_frame(m_fmt_ctx, m_packet);
     if (ret < 0) {
-      if (ret == AVERROR_EOF) {
-        m_is_end = true;
-        // 刷新解码器，获取剩余帧
-        if (avcodec_send_packet(m_dec_ctx, nullptr) >= 0) {
-          while (avcodec_receive_frame(m_dec_ctx, m_frame) == 0) {
-            frame_data_list.push_back(std::move(resampleFrame(m_frame)));
-          }
-        }
-      } else {
+      if (ret == AVERROR(EAGAIN)) {
+        // 非阻塞输入暂时没有数据，返回空列表由调用方等待
+        break;
+      }
+      if (ret != AVERROR_EOF) {
+        // 读错误按文件结束处理，避免调用方反复重试空转
         std::cerr << "Error reading packet: " << avErr2String(ret) << std::endl;
       }
+      m_is_end = true;
+      m_reached_track_end = ret == AVERROR_EOF;
+      if (ret == AVERROR_EOF && m_seek_index_pass) {
+        m_seek_index_pass = false;
+        m_seek_index_loaded = m_seek_index.save(m_in_fpath);
+      }
+      // 刷新解码器，获取剩余帧
+      if (avcodec_send_packet(m_dec_ctx, nullptr) >= 0) {
+        while (avcodec_receive_frame(m_dec_ctx, m_frame) == 0) {
+          appendFrame(frame_data_list, m_frame);
+        }
+      }
       break;
     }
 
     // 只处理音频流的包
     if (m_packet->stream_index != m_in_astream_idx) {
+      av_packet_unref(m_packet);
       continue;
     }
 
+    if (m_seek_index_pass) {
+      recordSeekIndex(m_packet);
+    }
     ret = avcodec_send_packet(m_dec_ctx, m_packet);
+    av_packet_unref(m_packet);
     if (ret < 0) {
       if (ret != AVERROR(EAGAIN)) {
         std::cerr << "Error sending packet: " << avErr2String(ret) << std::endl;
@@ -214,78 +582,214 @@ FrameDataList AudioDecoder::decodeNextFrameData() {
 
     // 接收解码帧
     while ((ret = avcodec_receive_frame(m_dec_ctx, m_frame)) == 0) {
-      frame_data_list.push_back(std::move(resampleFrame(m_frame)));
+      appendFrame(frame_data_list, m_frame);
     }
 
-    if (frame_data_list.size() > 0) {
+    if (frame_data_list.size() > 0 || m_is_end) {
       break;
     }
   }
-  return std::move(frame_data_list);
+  if (m_is_end && m_swr_ctx) {
+    // 到达结尾(或解码区间终点)时取出重采样器里滞留的尾部采样
+    auto tail = convertSamples(nullptr, 0);
+    if (tail.data) {
+      frame_data_list.push_back(tail);
+    }
+  }
+  return frame_data_list;
+}
+
+void AudioDecoder::appendFrame(FrameDataList &frame_data_list,
+                               AVFrame *frame) {
+  int skip_samples = seekSkipSamples(frame);
+  if (skip_samples >= frame->nb_samples) {
+    return;
+  }
+  int nb_samples = frame->nb_samples;
+  if (m_end_sample >= 0 && m_next_sample_pos >= m_end_sample) {
+    // 到达解码区间终点，截掉终点之后的采样
+    int64_t pos = m_next_sample_pos - frame->nb_samples;
+    nb_samples = (int)std::max<int64_t>(m_end_sample - pos, 0);
+    m_is_end = true;
+    m_reached_track_end = m_end_sample == m_gapless_end_sample;
+  }
+  if (nb_samples - skip_samples <= 0) {
+    return;
+  }
+  frame_data_list.push_back(
+      resampleFrame(frame, skip_samples, nb_samples - skip_samples));
 }
 
-FrameData AudioDecoder::resampleFrame(AVFrame *frame) {
-  if (!frame || frame->nb_samples <= 0) {
+// 返回帧首需要丢弃的采样数，整帧都在 seek 目标之前时返回 nb_samples
+int AudioDecoder::seekSkipSamples(AVFrame *frame) {
+  int64_t pos = m_next_sample_pos;
+  if (!m_ignore_timestamps && frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+    pos = av_rescale_q(frame->best_effort_timestamp - m_start_pts,
+                       m_dec_ctx->pkt_timebase,
+                       AVRational{1, m_dec_ctx->sample_rate});
+  }
+  m_next_sample_pos = pos + frame->nb_samples;
+  if (m_seek_target_sample < 0) {
+    return 0;
+  }
+  if (m_next_sample_pos <= m_seek_target_sample) {
+    return frame->nb_samples;
+  }
+  int skip_samples = (int)std::max<int64_t>(m_seek_target_sample - pos, 0);
+  m_seek_target_sample = -1;
+  return skip_samples;
+}
+
+FrameData AudioDecoder::resampleFrame(AVFrame *frame, int skip_samples,
+                                      int nb_samples) {
+  if (!frame || nb_samples <= 0 ||
+      skip_samples + nb_samples > frame->nb_samples) {
     return FrameData{nullptr, 0};
   }
+  const int bytes_per_sample = av_get_bytes_per_sample(m_dec_ctx->sample_fmt);
+  const int channels = m_dec_ctx->ch_layout.nb_channels;
+  if (!m_swr_ctx && av_sample_fmt_is_planar(m_dec_ctx->sample_fmt)) {
+    // 平面格式各声道的缓冲相互独立，拷贝到一块连续内存中
+    int linesize = nb_samples * bytes_per_sample;
+    auto pdata = m_buffer_pool.acquire(linesize * channels);
+    if (!pdata) {
+      return FrameData{nullptr, 0};
+    }
+    for (int i = 0; i < channels; i++) {
+      memcpy(pdata + i * linesize,
+             frame->extended_data[i] + skip_samples * bytes_per_sample,
+             linesize);
+    }
+    return FrameData{pdata, linesize * channels, nullptr, channels, linesize};
+  }
   if (!m_swr_ctx) {
-    int size =
-        av_samples_get_buffer_size(nullptr, m_dec_ctx->ch_layout.nb_channels,
-                                   frame->nb_samples, m_dec_ctx->sample_fmt, 1);
-    auto pdata = av_malloc(size);
-    memcpy(pdata, frame->data[0], size);
-    return FrameData{(uint8_t *)pdata, size};
+    int size = av_samples_get_buffer_size(nullptr, channels, nb_samples,
+                                          m_dec_ctx->sample_fmt, 1);
+    uint8_t *src = frame->data[0] + skip_samples * bytes_per_sample * channels;
+    // 交错格式的数据全部在 buf[0] 中，直接引用解码器的帧缓冲，省掉一次拷贝；
+    // 帧随后就会被 unref，把它持有的引用转交出去，不再新建 AVBufferRef
+    if (frame->buf[0] && src >= frame->buf[0]->data &&
+        src + size <= frame->buf[0]->data + frame->buf[0]->size) {
+      auto buf = frame->buf[0];
+      frame->buf[0] = nullptr;
+      return FrameData{src, size, buf};
+    }
+    auto pdata = m_buffer_pool.acquire(size);
+    if (!pdata) {
+      return FrameData{nullptr, 0};
+    }
+    memcpy(pdata, src, size);
+    return FrameData{pdata, size};
   }
 
+  // seek 后帧首的多余采样在重采样前丢弃
+  const uint8_t *in_data[kMaxChannels] = {nullptr};
+  if (av_sample_fmt_is_planar(m_dec_ctx->sample_fmt)) {
+    for (int i = 0; i < channels && i < kMaxChannels; i++) {
+      in_data[i] = frame->extended_data[i] + skip_samples * bytes_per_sample;
+    }
+  } else {
+    in_data[0] = frame->data[0] + skip_samples * bytes_per_sample * channels;
+  }
+  return convertSamples(in_data, nb_samples);
+}
+
+FrameData AudioDecoder::convertSamples(const uint8_t **in_data,
+                                       int nb_samples) {
   int out_samples = av_rescale_rnd(
-      frame->nb_samples + swr_get_delay(m_swr_ctx, m_dec_ctx->sample_rate),
+      nb_samples + swr_get_delay(m_swr_ctx, m_dec_ctx->sample_rate),
       m_target_sample_rate, m_dec_ctx->sample_rate, AV_ROUND_UP);
 
   if (out_samples <= 0) {
     return FrameData{nullptr, 0};
   }
 
-  uint8_t **audio_data = nullptr;
-  int linesize;
-
-  int ret = av_samples_alloc_array_and_samples(&audio_data, &linesize,
-                                               m_target_channels, out_samples,
-                                               m_target_sample_format, 0);
-  if (ret < 0) {
-    std::cerr << "Error allocating audio buffer: " << avErr2String(ret)
-              << std::endl;
+  int buffer_size = av_samples_get_buffer_size(
+      nullptr, m_target_channels, out_samples, m_target_sample_format, 1);
+  uint8_t *pdata = m_buffer_pool.acquire(buffer_size);
+  if (!pdata) {
+    std::cerr << "Error allocating audio buffer" << std::endl;
     return FrameData{nullptr, 0};
   }
 
-  int num =
-      swr_convert(m_swr_ctx, audio_data, out_samples,
-                  const_cast<const uint8_t **>(frame->data), frame->nb_samples);
+  // 平面输出时各平面在同一块内存中依次排列
+  const bool planar_out = av_sample_fmt_is_planar(m_target_sample_format);
+  const int linesize =
+      out_samples * av_get_bytes_per_sample(m_target_sample_format);
+  uint8_t *out_data[kMaxChannels] = {pdata};
+  if (planar_out) {
+    for (int i = 1; i < m_target_channels; i++) {
+      out_data[i] = pdata + i * linesize;
+    }
+  }
+
+  int num = swr_convert(m_swr_ctx, out_data, out_samples, in_data, nb_samples);
   if (num <= 0) {
-    std::cerr << "Error converting frame: " << avErr2String(num) << std::endl;
-    if (audio_data) {
-      av_freep(&audio_data[0]);
-      av_freep(&audio_data);
+    if (num < 0) {
+      std::cerr << "Error converting frame: " << avErr2String(num)
+                << std::endl;
     }
+    m_buffer_pool.release(pdata);
     return FrameData{nullptr, 0};
   }
 
-  int size = av_samples_get_buffer_size(&linesize, m_target_channels, num,
+  int size = av_samples_get_buffer_size(nullptr, m_target_channels, num,
                                         m_target_sample_format, 1);
-  auto pdata = audio_data[0];
-  av_freep(&audio_data);
-  return std::move(FrameData{pdata, size});
+  if (planar_out) {
+    return FrameData{pdata, size, nullptr, m_target_channels, linesize};
+  }
+  return FrameData{pdata, size};
+}
+
+void AudioDecoder::seek(int64_t time_ms) { seekPosition(time_ms, 1000); }
+
+void AudioDecoder::seekFrame(int64_t frame) {
+  seekPosition(frame, m_target_sample_rate);
 }
 
-void AudioDecoder::seek(int64_t time_ms) {
+void AudioDecoder::seekPosition(int64_t pos, int rate) {
   if (!m_fmt_ctx) {
     return;
   }
-  if (time_ms <= 0) {
-    av_seek_frame(m_fmt_ctx, m_in_astream_idx, 0, AVSEEK_FLAG_BACKWARD);
-  } else {
-    av_seek_frame(m_fmt_ctx, m_in_astream_idx, time_ms * AV_TIME_BASE / 1000,
-                  AVSEEK_FLAG_BACKWARD);
+  if (!seekable()) {
+    std::cerr << "Error seeking: input is not seekable" << std::endl;
+    return;
+  }
+  pos = std::max<int64_t>(pos, 0);
+  AVStream *stream = m_fmt_ctx->streams[m_in_astream_idx];
+  // 指定了流索引时时间戳必须使用该流的 time_base
+  int64_t ts =
+      av_rescale_q(pos, AVRational{1, rate}, stream->time_base) + m_start_pts;
+  // 中途 seek 后解码不再连续，放弃建立索引
+  m_seek_index_pass = false;
+  m_ignore_timestamps = false;
+  if (!m_seek_index_loaded || !seekByIndex(ts)) {
+    // 和按索引跳转一样提前一段，多解的采样按 m_seek_target_sample 丢弃
+    auto preroll = av_rescale_q(kSeekPrerollMs, AVRational{1, 1000},
+                                stream->time_base);
+    int ret = av_seek_frame(m_fmt_ctx, m_in_astream_idx,
+                            std::max(ts - preroll, m_start_pts),
+                            AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      std::cerr << "Error seeking: " << avErr2String(ret) << std::endl;
+    }
   }
-  m_is_end = false;
   avcodec_flush_buffers(m_dec_ctx);
+  if (m_swr_ctx) {
+    // 重新初始化以丢弃重采样器内部缓存的旧采样
+    swr_init(m_swr_ctx);
+  }
+  m_seek_target_sample = av_rescale(pos, m_dec_ctx->sample_rate, rate);
+  if (!m_ignore_timestamps) {
+    m_next_sample_pos = m_seek_target_sample;
+  }
+  m_is_end = false;
+  m_reached_track_end = false;
+}
+
+int64_t AudioDecoder::position() const {
+  if (!m_dec_ctx || m_dec_ctx->sample_rate <= 0) {
+    return 0;
+  }
+  return av_rescale(m_next_sample_pos, 1000, m_dec_ctx->sample_rate);
 }
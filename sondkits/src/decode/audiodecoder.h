@@ -1,6 +1,10 @@
 #pragma once
 
+#include "bufferpool.h"
+#include "bytesource.h"
 #include "decoder.h"
+#include "probecache.h"
+#include "seekindex.h"
 #include <cstdint>
 #include <filesystem>
 extern "C" {
@@ -11,30 +15,83 @@ extern "C" {
 
 class AudioDecoder : public DecoderInterface {
 public:
+  // target_sample_format 可以是平面格式(如 FLTP)，输出的 FrameData 按平面排列
   AudioDecoder(int target_sample_rate, int target_channels,
                AVSampleFormat target_sample_format);
   virtual ~AudioDecoder() override;
 
   void open(const std::filesystem::path &in_fpath);
+  // 通过自定义 AVIOContext 从内存、mmap 文件或其他字节来源解码；
+  // 不可 seek 的来源(管道、标准输入)按流式模式打开：探测窗口受限，
+  // 不要求时长，内存占用由 IO 缓冲和 DecodeQueue 水位决定
+  void open(std::shared_ptr<ByteSource> source);
   void close();
-  FrameDataList decodeNextFrameData() override;
+  FrameDataList &decodeNextFrameData() override;
   bool isEnd() const override;
-  void freeData(uint8_t **data) override;
-  void seek(int64_t time_ms);
+  // 已完整解码到曲目末尾：正常读到文件结尾或无缝播放的结尾，
+  // 读错误和 setEndPosition 设置的终点都不算
+  bool reachedTrackEnd() const;
+  void freeData(FrameData &data) override;
+  int64_t bytesPerSecond() const override;
+  int planes() const override;
+  // 精确到采样点：先跳到目标前的关键帧，再解码丢弃到目标采样
+  // 时间 0 为去掉编码延迟后的第一个采样
+  void seek(int64_t time_ms) override;
+  void seekFrame(int64_t frame) override;
+  // 下一个输出采样在源文件中的位置(ms)
+  int64_t position() const;
+  // 解码到该位置(ms)为止，之后 isEnd 返回 true；-1 表示解码到文件末尾
+  // (有无缝播放信息时为去掉补齐之后的末尾)
+  void setEndPosition(int64_t time_ms);
+  // 按无缝播放信息在开头丢弃的编码延迟(源采样数)
+  int64_t primingSamples() const;
+  const std::filesystem::path &path() const;
+  // 快速打开：限制探测量，需在 open 之前设置
+  // 同一文件再次打开时复用进程内缓存的探测结果，但完整打开不使用
+  // 快速打开留下的结果
+  void setFastOpen(bool fast_open);
+  // 从字节来源打开时返回该来源，否则为空
+  std::shared_ptr<ByteSource> byteSource() const;
   AVFormatContext *fmtCtx() const;
   AVCodecContext *codecCtx() const;
   int audioStreamIndex() const;
+  // 时长未知(如流式输入)时返回 0
   double duration() const;
+  bool seekable() const;
   int targetSampleRate() const;
   int targetChannels() const;
   AVSampleFormat targetSampleFormat() const;
   int sampleRate() const;
   int channels() const;
   AVSampleFormat sampleFormat() const;
+  // 输出缓冲池累计的堆分配次数。帧列表复用，直通的帧转交解码器的引用，
+  // 稳态解码时这些都不再分配；FFmpeg 内部(如解复用读包)的分配不在其中
+  int64_t bufferAllocations() const;
+  // 从头到尾完整解码时建立包索引并写入旁路文件，需在 open 之前设置
+  void setBuildSeekIndex(bool build);
+  bool hasSeekIndex() const;
+  // 当前解码过程是否正在建立索引
+  bool isBuildingSeekIndex() const;
 
 private:
+  void openStream(const ProbeCache::Entry *probe);
+  AVDictionary *probeOptions(bool streaming) const;
+  bool applyProbeResult(const ProbeCache::Entry &probe);
+  static int ioRead(void *opaque, uint8_t *buf, int buf_size);
+  static int64_t ioSeek(void *opaque, int64_t offset, int whence);
   void initSwr();
-  FrameData resampleFrame(AVFrame *frame);
+  void reserveBufferPool();
+  void applyGaplessInfo(const AVStream *stream);
+  void appendFrame(FrameDataList &frame_data_list, AVFrame *frame);
+  int seekSkipSamples(AVFrame *frame);
+  FrameData resampleFrame(AVFrame *frame, int skip_samples, int nb_samples);
+  // in_data 为空时取出重采样器内部缓存的剩余采样
+  FrameData convertSamples(const uint8_t **in_data, int nb_samples);
+  bool needSeekIndex() const;
+  void recordSeekIndex(const AVPacket *packet);
+  bool seekByIndex(int64_t target_pts);
+  // 定位到 pos / rate 秒
+  void seekPosition(int64_t pos, int rate);
 
 private:
   AVFormatContext *m_fmt_ctx;
@@ -44,11 +101,37 @@ private:
   // buffer
   AVPacket *m_packet;
   AVFrame *m_frame;
+  BufferPool m_buffer_pool;
+  FrameDataList m_frame_data_list;
+
+  // custom io
+  AVIOContext *m_avio_ctx;
+  std::shared_ptr<ByteSource> m_io_source;
+  int64_t m_io_pos;
+  bool m_fast_open;
 
   int m_in_astream_idx;
+  int64_t m_start_pts;
+  // 以源采样率计的位置
+  int64_t m_next_sample_pos;
+  int64_t m_seek_target_sample;
+  int64_t m_end_sample;
+  // 无缝播放：开头的编码延迟和去掉末尾补齐后的总采样数(-1 表示未知)
+  int64_t m_priming_samples;
+  int64_t m_gapless_end_sample;
+  // 按字节偏移定位后，时间戳不可信，只按解码出的采样数累计位置
+  bool m_ignore_timestamps;
+
+  std::filesystem::path m_in_fpath;
+  SeekIndex m_seek_index;
+  bool m_build_seek_index;
+  bool m_seek_index_loaded;
+  // 本次解码是否从文件开头连续进行，只有这样建立的索引才完整
+  bool m_seek_index_pass;
   int m_target_sample_rate;
   int m_target_channels;
   int m_target_sample_size;
   AVSampleFormat m_target_sample_format;
   bool m_is_end;
+  bool m_reached_track_end;
 };
@@ -0,0 +1,103 @@
+#include "bytesource.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+static int64_t readFromBuffer(const uint8_t *buffer, int64_t buffer_size,
+                              int64_t offset, uint8_t *data, int64_t size) {
+  if (!data || size <= 0 || offset < 0) {
+    return offset < 0 ? -1 : 0;
+  }
+  if (offset >= buffer_size) {
+    return 0;
+  }
+  auto len = std::min(size, buffer_size - offset);
+  memcpy(data, buffer + offset, len);
+  return len;
+}
+
+MemoryByteSource::MemoryByteSource(std::vector<uint8_t> data)
+    : m_storage(std::move(data)), m_data(m_storage.data()),
+      m_size(static_cast<int64_t>(m_storage.size())) {}
+
+MemoryByteSource::MemoryByteSource(const uint8_t *data, int64_t size,
+                                   std::shared_ptr<const void> owner)
+    : m_owner(owner), m_data(data), m_size(size) {}
+
+int64_t MemoryByteSource::readAt(int64_t offset, uint8_t *data,
+                                 int64_t size) {
+  return readFromBuffer(m_data, m_size, offset, data, size);
+}
+
+int64_t MemoryByteSource::size() const { return m_size; }
+
+const uint8_t *MemoryByteSource::data() const { return m_data; }
+
+MappedFileByteSource::MappedFileByteSource(const std::filesystem::path &path)
+    : m_file(path) {}
+
+int64_t MappedFileByteSource::readAt(int64_t offset, uint8_t *data,
+                                     int64_t size) {
+  return readFromBuffer(m_file.data(), m_file.size(), offset, data, size);
+}
+
+int64_t MappedFileByteSource::size() const { return m_file.size(); }
+
+const uint8_t *MappedFileByteSource::data() const { return m_file.data(); }
+
+StreamByteSource::StreamByteSource(const std::filesystem::path &path)
+    : m_file(nullptr), m_owns_file(false), m_pos(0) {
+  if (path == "-") {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    m_file = stdin;
+    return;
+  }
+#ifdef _WIN32
+  m_file = _wfopen(path.wstring().c_str(), L"rb");
+#else
+  m_file = fopen(path.c_str(), "rb");
+#endif
+  if (!m_file) {
+    throw std::runtime_error("Failed to open stream: " + path.u8string());
+  }
+  m_owns_file = true;
+}
+
+StreamByteSource::~StreamByteSource() {
+  if (m_owns_file && m_file) {
+    fclose(m_file);
+  }
+}
+
+int64_t StreamByteSource::readAt(int64_t offset, uint8_t *data, int64_t size) {
+  if (offset != m_pos) {
+    return -1;
+  }
+  if (!data || size <= 0) {
+    return 0;
+  }
+  auto r = fread(data, 1, static_cast<size_t>(size), m_file);
+  if (r == 0 && ferror(m_file)) {
+    return -1;
+  }
+  m_pos += static_cast<int64_t>(r);
+  return static_cast<int64_t>(r);
+}
+
+int64_t StreamByteSource::size() const { return -1; }
+
+bool StreamByteSource::isStreamPath(const std::filesystem::path &path) {
+  if (path == "-") {
+    return true;
+  }
+  std::error_code ec;
+  auto type = std::filesystem::status(path, ec).type();
+  return !ec && (type == std::filesystem::file_type::fifo ||
+                 type == std::filesystem::file_type::character);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "mappedfile.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// 压缩音频的字节来源，供 AudioDecoder 通过自定义 AVIOContext 解码
+// 接口按偏移读取、自身不保存读位置，同一个实例可以被多个解码器共享
+class ByteSource {
+public:
+  virtual ~ByteSource() = default;
+  // 从 offset 处读取最多 size 字节，返回实际字节数，0 表示结束，<0 表示错误
+  virtual int64_t readAt(int64_t offset, uint8_t *data, int64_t size) = 0;
+  // 总字节数，未知时返回 -1
+  virtual int64_t size() const = 0;
+  virtual bool seekable() const { return size() >= 0; }
+};
+
+// 内存中的压缩数据，常驻内存的热门曲目避免重复从网络存储读取
+class MemoryByteSource : public ByteSource {
+public:
+  explicit MemoryByteSource(std::vector<uint8_t> data);
+  // 引用外部内存，owner 负责其生命周期
+  MemoryByteSource(const uint8_t *data, int64_t size,
+                   std::shared_ptr<const void> owner = nullptr);
+
+  int64_t readAt(int64_t offset, uint8_t *data, int64_t size) override;
+  int64_t size() const override;
+  const uint8_t *data() const;
+
+private:
+  std::vector<uint8_t> m_storage;
+  std::shared_ptr<const void> m_owner;
+  const uint8_t *m_data;
+  int64_t m_size;
+};
+
+// 内存映射的文件，读取直接从页缓存拷贝，没有 read 系统调用。
+// 经 AVIO 解码时 readAt 仍要把数据拷进 AVIO 缓冲，并不是零拷贝；
+// 需要直接访问映射内存时使用 data()
+class MappedFileByteSource : public ByteSource {
+public:
+  explicit MappedFileByteSource(const std::filesystem::path &path);
+
+  int64_t readAt(int64_t offset, uint8_t *data, int64_t size) override;
+  int64_t size() const override;
+  const uint8_t *data() const;
+
+private:
+  MappedFile m_file;
+};
+
+// 只能顺序读取的字节流(标准输入、管道、FIFO)，大小未知、不可 seek
+// readAt 的 offset 必须等于已读取的字节数，不能被多个解码器共享
+class StreamByteSource : public ByteSource {
+public:
+  // "-" 表示标准输入
+  explicit StreamByteSource(const std::filesystem::path &path);
+  ~StreamByteSource() override;
+  StreamByteSource(const StreamByteSource &) = delete;
+  StreamByteSource &operator=(const StreamByteSource &) = delete;
+
+  int64_t readAt(int64_t offset, uint8_t *data, int64_t size) override;
+  int64_t size() const override;
+
+  // "-"、命名管道和字符设备只能按流读取
+  static bool isStreamPath(const std::filesystem::path &path);
+
+private:
+  FILE *m_file;
+  bool m_owns_file;
+  int64_t m_pos;
+};
@@ -1,17 +1,64 @@
-
 #include "decodequeue.h"
 #include "decoder.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <mutex>
 
+static int64_t outputBytesPerSecond(DecoderInterface *decoder) {
+  auto bytes = decoder ? decoder->bytesPerSecond() : 0;
+  if (bytes <= 0) {
+    // 未知格式时按 44.1kHz 双声道 float 估算
+    bytes = 44100 * 2 * 4;
+  }
+  return bytes;
+}
+
 DecodeQueue::DecodeQueue(std::shared_ptr<DecoderInterface> decoder,
-                         int max_frames_size)
-    : m_decoder(decoder), m_max_frames_size(max_frames_size),
-      m_decode_loop_stopped(false), m_abort(false), m_front_pos(0),
-      m_datas_byte_size(0) {}
+                         int64_t high_watermark_ms, int64_t low_watermark_ms)
+    : m_bytes_per_second(outputBytesPerSecond(decoder.get())),
+      m_planes(std::max(decoder ? decoder->planes() : 1, 1)),
+      m_high_watermark(std::max<int64_t>(
+          m_bytes_per_second * high_watermark_ms / 1000 / m_planes, 1)),
+      m_low_watermark(std::clamp<int64_t>(
+          m_bytes_per_second * low_watermark_ms / 1000 / m_planes, 0,
+          m_high_watermark)),
+      m_fill_limit(m_high_watermark),
+      // 高水位之上留出余量，容纳越过高水位的最后一批解码帧
+      m_ring(m_high_watermark + m_high_watermark / 2),
+      m_reader_waiting(false), m_writer_waiting(false),
+      m_writer_wake_level(0), m_input_waiting(false),
+      m_input_signaled(false), m_decoder(decoder),
+      m_thread_role(ThreadRole::Decode),
+      m_decode_loop_stopped(false), m_abort(false),
+      m_seek_pending(false), m_seek_target(0), m_seek_by_frame(false),
+      m_flush_pending(false), m_flush_position(0), m_flush_serial(0),
+      m_seek_request_time(0), m_last_seek_latency(-1), m_measure_seek(false),
+      m_start_time(0), m_decode_idle_us(0), m_decode_wakeups(0),
+      m_underruns(0) {
+  for (int i = 1; i < m_planes; i++) {
+    m_plane_rings.push_back(std::make_unique<RingBuffer>(m_ring.capacity()));
+  }
+}
+
+static int64_t steadyNowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
 
 DecodeQueue::~DecodeQueue() { stop(); }
 
+void DecodeQueue::setThreadRole(ThreadRole role) { m_thread_role = role; }
+
 void DecodeQueue::start() {
+  if (m_decode_thread.joinable()) {
+    return;
+  }
+  m_start_time.store(steadyNowUs());
+  m_decode_idle_us.store(0);
+  m_decode_wakeups.store(0);
+  m_underruns.store(0);
   m_abort.store(false);
   m_decode_loop_stopped.store(false);
   m_decode_thread = std::thread([this]() { decode_loop(); });
@@ -24,151 +71,365 @@ void DecodeQueue::restart() {
 }
 
 void DecodeQueue::clear() {
-  std::unique_lock<std::mutex> lock(m_mutex);
-  m_frames.clear();
-  m_front_pos.store(0);
-  m_datas_byte_size.store(0);
+  // 调用方需保证解码线程已停止且没有并发读取
+  m_ring.reset();
+  for (auto &ring : m_plane_rings) {
+    ring->reset();
+  }
+  m_flush_pending.store(false);
+}
+
+void DecodeQueue::seek(int64_t time_ms) { request_seek(time_ms, false); }
+
+void DecodeQueue::seekFrame(int64_t frame) { request_seek(frame, true); }
+
+// 解码线程先清除 pending 再读取目标，并发的第二次 seek 即使读到一半，
+// 其 pending 也会让解码线程按完整的新目标再定位一次
+void DecodeQueue::request_seek(int64_t target, bool by_frame) {
+  m_seek_request_time.store(steadyNowUs());
+  m_last_seek_latency.store(-1);
+  m_seek_target.store(target);
+  m_seek_by_frame.store(by_frame);
+  m_seek_pending.store(true);
+  // 解码线程可能停在高水位或文件末尾，加锁通知保证不丢失唤醒
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cv_decode.notify_all();
+}
+
+int64_t DecodeQueue::flushSerial() const { return m_flush_serial.load(); }
+
+int64_t DecodeQueue::lastSeekLatency() const {
+  return m_last_seek_latency.load();
+}
+
+DecodeQueueStats DecodeQueue::stats() const {
+  DecodeQueueStats stats;
+  auto start_time = m_start_time.load();
+  stats.elapsed_us = start_time > 0 ? steadyNowUs() - start_time : 0;
+  stats.decode_idle_us = m_decode_idle_us.load();
+  stats.decode_wakeups = m_decode_wakeups.load();
+  stats.underruns = m_underruns.load();
+  return stats;
 }
 
 void DecodeQueue::stop() {
-  m_abort.store(true);
-  stop_loop();
+  abort();
   if (m_decode_thread.joinable()) {
     m_decode_thread.join();
   }
 }
 
+void DecodeQueue::abort() {
+  m_abort.store(true);
+  stop_loop();
+}
+
+void DecodeQueue::setPrerollLead(int64_t lead_ms) {
+  int64_t limit = m_high_watermark;
+  if (lead_ms > 0) {
+    limit = std::clamp<int64_t>(
+        m_bytes_per_second * lead_ms / 1000 / m_planes, 1, m_high_watermark);
+  }
+  m_fill_limit.store(limit);
+  // 解码线程可能停在旧的上限，放宽后唤醒它重新检查
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_writer_waiting.load()) {
+    m_writer_wake_level.store(std::numeric_limits<int64_t>::max());
+    m_cv_decode.notify_all();
+  }
+}
+
 bool DecodeQueue::aborted() { return m_abort.load(); }
 
 bool DecodeQueue::canRead() {
-  return aborted() || (is_empty() && is_decode_stopped());
+  return aborted() || (is_empty() && is_finished() && !m_flush_pending.load());
 }
 
+// readData 在没有数据时会阻塞等待，返回 0 说明已结束或被中止
 int64_t DecodeQueue::readDataUntil(uint8_t *buffer, int64_t buffer_size) {
   int64_t readed = 0;
-  while (!canRead()) {
-    readed += readData(buffer + readed, buffer_size - readed);
-    if (readed >= buffer_size) {
+  while (readed < buffer_size) {
+    auto r = readData(buffer + readed, buffer_size - readed);
+    if (r <= 0) {
       break;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    readed += r;
   }
   return readed;
 }
 
 int64_t DecodeQueue::readData(uint8_t *buffer, int64_t buffer_size) {
-  std::unique_lock<std::mutex> lock(m_mutex);
-  while (is_empty()) {
+  // 平面格式的数据不能按交错方式读取
+  if (m_planes != 1) {
+    return 0;
+  }
+  return read_planes(&buffer, buffer_size);
+}
+
+int64_t DecodeQueue::readPlanarData(uint8_t *const *planes,
+                                    int64_t plane_size) {
+  if (!planes) {
+    return 0;
+  }
+  return read_planes(planes, plane_size);
+}
+
+int DecodeQueue::planes() const { return m_planes; }
+
+// 先读其他平面，最后读平面 0：写端按平面 0 的可写空间判断是否有空位
+int64_t DecodeQueue::read_rings(uint8_t *const *planes, int64_t size) {
+  auto len = std::min(size, m_ring.readable());
+  if (len <= 0) {
+    return 0;
+  }
+  for (size_t i = 0; i < m_plane_rings.size(); i++) {
+    m_plane_rings[i]->read(planes[i + 1], len);
+  }
+  return m_ring.read(planes[0], len);
+}
+
+// 在音频回调线程上调用：有数据时不加锁、不释放内存
+template <typename Read> int64_t DecodeQueue::read_blocking(Read &&read) {
+  flush_stale_data();
+  int64_t readed = read();
+  while (readed == 0) {
     if (aborted()) {
       return 0;
     }
-    m_cv_read.wait(lock, [this]() -> bool {
-      return aborted() || !is_empty() || is_decode_stopped();
-    });
+    if (is_finished()) {
+      readed = read();
+      break;
+    }
+    // 欠载：等待解码线程写入
+    wait_readable();
+    flush_stale_data();
+    readed = read();
+  }
+  if (readed > 0 && m_measure_seek) {
+    m_measure_seek = false;
+    m_last_seek_latency.store(steadyNowUs() - m_seek_request_time.load());
   }
+  return readed;
+}
 
-  int64_t readed = 0;
-  bool first = true;
-
-  int count = 0;
-  for (auto it = m_frames.begin();
-       it != m_frames.end() && readed < buffer_size;) {
-    auto &data = *it;
-    int pos = 0;
-    int size = data.size;
-    if (first) {
-      pos = m_front_pos.load();
-      size -= pos;
-      first = false;
-    }
+int64_t DecodeQueue::read_planes(uint8_t *const *planes, int64_t size) {
+  auto readed =
+      read_blocking([&]() -> int64_t { return read_rings(planes, size); });
+  if (readed > 0) {
+    notify_writer();
+  }
+  return readed;
+}
 
-    if (buffer_size - readed >= size) {
-      memcpy(buffer + readed, data.data + pos, size);
-      readed += size;
-
-      m_decoder->freeData(&data.data);
-      it = m_frames.erase(it);
-      m_front_pos.store(0);
-      m_datas_byte_size.fetch_sub(size);
-    } else {
-      auto copyed = buffer_size - readed;
-      memcpy(buffer + readed, data.data + pos, copyed);
-      readed += copyed;
-      m_front_pos.fetch_add(copyed);
-      ++it;
-    }
+int64_t DecodeQueue::acquireRead(uint8_t **data, int64_t max_size) {
+  if (m_planes != 1 || !data || max_size <= 0) {
+    return 0;
   }
+  return read_blocking([&]() -> int64_t {
+    return std::min(m_ring.acquireRead(data), max_size);
+  });
+}
 
-  m_cv_decode.notify_one();
-  return readed;
+void DecodeQueue::commitRead(int64_t size) {
+  if (m_ring.commitRead(size) > 0) {
+    notify_writer();
+  }
 }
 
-int64_t DecodeQueue::bytesAvailable() {
-  return m_datas_byte_size.load() - m_front_pos.load();
+// 读端执行：丢弃 seek 之前写入的旧数据
+void DecodeQueue::flush_stale_data() {
+  if (!m_flush_pending.exchange(false)) {
+    return;
+  }
+  auto position = m_flush_position.load();
+  for (auto &ring : m_plane_rings) {
+    ring->discardTo(position);
+  }
+  m_ring.discardTo(position);
+  m_flush_serial.fetch_add(1);
+  m_measure_seek = true;
+  notify_writer();
 }
 
-FrameData DecodeQueue::pop() {
-  std::unique_lock<std::mutex> lock(m_mutex);
-  while (is_empty()) {
-    if (aborted()) {
-      return FrameData();
+int64_t DecodeQueue::bytesAvailable() { return m_ring.readable() * m_planes; }
+
+int64_t DecodeQueue::bufferedDuration() {
+  return m_ring.readable() * m_planes * 1000 / m_bytes_per_second;
+}
+
+int64_t DecodeQueue::highWatermarkBytes() const {
+  return m_high_watermark * m_planes;
+}
+
+int64_t DecodeQueue::lowWatermarkBytes() const {
+  return m_low_watermark * m_planes;
+}
+
+void DecodeQueue::push(FrameDataList &items) {
+  for (auto &data : items) {
+    int64_t written = 0;
+    // 平面数与队列不一致的数据无法按平面写入，直接丢弃
+    const int64_t plane_size =
+        data.planes == m_planes ? data.planeSize() : 0;
+    while (data.data && written < plane_size && !aborted() &&
+           !seek_pending()) {
+      // 整帧写入，保证读端拿到的数据始终按帧对齐
+      auto need = std::min<int64_t>(plane_size - written, m_ring.capacity());
+      if (m_ring.writable() < need) {
+        wait_writer(m_ring.capacity() - need);
+        continue;
+      }
+      // 平面 0 最后写入，读端看到它时其他平面的数据已经就绪
+      for (size_t i = 0; i < m_plane_rings.size(); i++) {
+        m_plane_rings[i]->write(data.plane(i + 1) + written, need);
+      }
+      written += m_ring.write(data.plane(0) + written, need);
+      notify_reader();
     }
-    m_cv_read.wait(lock, [this]() -> bool {
-      return aborted() || !is_empty() || is_decode_stopped();
-    });
+    m_decoder->freeData(data);
   }
-  auto data = m_frames.front();
-  m_frames.pop_front();
+}
 
-  m_front_pos.store(0);
-  m_datas_byte_size.fetch_sub(data.size);
+void DecodeQueue::wait_writer(int64_t wake_level) {
+  auto start = steadyNowUs();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_writer_wake_level.store(wake_level);
+  m_writer_waiting.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  m_cv_decode.wait(lock, [this]() -> bool {
+    return aborted() || seek_pending() ||
+           m_ring.readable() <= m_writer_wake_level.load();
+  });
+  m_writer_waiting.store(false);
+  m_decode_wakeups.fetch_add(1);
+  m_decode_idle_us.fetch_add(steadyNowUs() - start);
+}
 
-  m_cv_decode.notify_one();
-  return std::move(data);
+void DecodeQueue::notifyInput() {
+  m_input_signaled.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_input_waiting.load()) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cv_decode.notify_all();
+  }
 }
 
-void DecodeQueue::push(FrameDataList &&items) {
+// 输入暂时无数据(EAGAIN)时等待 notifyInput、seek 或停止唤醒；
+// 超时只是兜底，防止不会通知的输入(如 FFmpeg 内部协议)永远停住
+void DecodeQueue::wait_input() {
+  auto start = steadyNowUs();
   std::unique_lock<std::mutex> lock(m_mutex);
-  while (is_full()) {
-    if (aborted()) {
-      return;
-    }
-    m_cv_decode.wait(lock);
+  m_input_waiting.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  m_cv_decode.wait_for(lock, std::chrono::seconds(1), [this]() -> bool {
+    return aborted() || seek_pending() || m_input_signaled.load();
+  });
+  m_input_waiting.store(false);
+  m_input_signaled.store(false);
+  m_decode_wakeups.fetch_add(1);
+  m_decode_idle_us.fetch_add(steadyNowUs() - start);
+}
+
+void DecodeQueue::wait_readable() {
+  m_underruns.fetch_add(1);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_reader_waiting.store(true);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  m_cv_read.wait(lock, [this]() -> bool {
+    return aborted() || !is_empty() || is_finished() ||
+           m_flush_pending.load();
+  });
+  m_reader_waiting.store(false);
+}
+
+// 只有对端确实在等待时才短暂获取互斥量，避免丢失唤醒
+void DecodeQueue::notify_writer() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_writer_waiting.load() &&
+      m_ring.readable() <= m_writer_wake_level.load()) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cv_decode.notify_one();
   }
-  for (auto &data : items) {
-    m_datas_byte_size.fetch_add(data.size);
-    m_frames.push_back(std::move(data));
+}
+
+void DecodeQueue::notify_reader() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_reader_waiting.load()) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cv_read.notify_one();
   }
-  m_cv_read.notify_one();
+}
+
+bool DecodeQueue::seek_pending() { return m_seek_pending.load(); }
+
+// 解码线程执行：定位解码器并标记需要读端丢弃的旧数据
+void DecodeQueue::do_seek() {
+  m_seek_pending.store(false);
+  auto target = m_seek_target.load();
+  if (m_seek_by_frame.load()) {
+    m_decoder->seekFrame(target);
+  } else {
+    m_decoder->seek(target);
+  }
+  m_flush_position.store(m_ring.writePosition());
+  m_flush_pending.store(true);
+  m_decode_loop_stopped.store(false);
+  notify_reader();
 }
 
 void DecodeQueue::decode_loop() {
+  promoteCurrentThread(m_thread_role);
   while (!aborted()) {
-    auto data = m_decoder->decodeNextFrameData();
-    if (aborted()) {
-      break;
+    if (seek_pending()) {
+      do_seek();
+      continue;
+    }
+    if (is_decode_stopped()) {
+      // 已解码到文件末尾，等待 seek 或停止
+      wait_writer(-1);
+      continue;
+    }
+    auto fill_limit = m_fill_limit.load();
+    if (m_ring.readable() >= fill_limit) {
+      // 缓冲已满，休眠到低水位再连续解码
+      wait_writer(std::min(m_low_watermark, fill_limit));
+      continue;
+    }
+    auto &data = m_decoder->decodeNextFrameData();
+    if (aborted() || seek_pending()) {
+      for (auto &item : data) {
+        m_decoder->freeData(item);
+      }
+      continue;
     }
 
     if (data.empty()) {
       if (m_decoder->isEnd()) {
-        break;
+        m_decode_loop_stopped.store(true);
+        notify_reader();
+        continue;
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(0));
+      wait_input();
       continue;
     }
-    push(std::move(data));
+    push(data);
   }
   stop_loop();
 }
 
 void DecodeQueue::stop_loop() {
   m_decode_loop_stopped.store(true);
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_cv_read.notify_all();
   m_cv_decode.notify_all();
 }
 
-bool DecodeQueue::is_empty() { return m_frames.empty(); }
+bool DecodeQueue::is_empty() { return m_ring.readable() == 0; }
 
-bool DecodeQueue::is_full() { return m_frames.size() >= m_max_frames_size; }
+bool DecodeQueue::is_decode_stopped() { return m_decode_loop_stopped.load(); }
 
-bool DecodeQueue::is_decode_stopped() { return m_decode_loop_stopped.load(); }
\ No newline at end of file
+// 已结束后再 seek 时，解码线程执行之前也不算结束，读端继续等待新数据，
+// 输出设备也不会因此停止
+bool DecodeQueue::is_finished() {
+  return is_decode_stopped() && !seek_pending();
+}
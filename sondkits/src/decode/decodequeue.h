@@ -1,57 +1,155 @@
 #pragma once
 
 #include "decoder.h"
+#include "ringbuffer.h"
+#include "threadschedule.h"
 #include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/avutil.h>
 #include <libswresample/swresample.h>
 }
 
+// 解码线程活动统计，用于确认暂停/缓冲满时解码线程处于休眠
+struct DecodeQueueStats {
+  // 自 start 起经过的时间
+  int64_t elapsed_us = 0;
+  // 解码线程阻塞等待的累计时间
+  int64_t decode_idle_us = 0;
+  // 解码线程被唤醒的次数
+  int64_t decode_wakeups = 0;
+  // 读端因缓冲为空而等待的次数
+  int64_t underruns = 0;
+
+  double decodeIdleRatio() const {
+    return elapsed_us > 0 ? double(decode_idle_us) / elapsed_us : 0.0;
+  }
+};
+
 class DecodeQueue {
 public:
+  // 按输出 PCM 时长控制缓冲：缓冲达到高水位后解码线程休眠，
+  // 读到低水位以下再被唤醒，连续解码直到高水位
   DecodeQueue(std::shared_ptr<DecoderInterface> decoder,
-              int max_frames_size = 350);
+              int64_t high_watermark_ms = 3000,
+              int64_t low_watermark_ms = 1500);
   ~DecodeQueue();
 
+  // 解码线程的调度角色，需在 start 之前设置，默认按播放解码线程调度
+  void setThreadRole(ThreadRole role);
   void start();
   void stop();
+  // 只通知解码线程退出、不等待，可在读线程调用，之后仍需 stop 回收线程
+  void abort();
+  // 预读时只缓冲 lead_ms 就停止解码，<=0 恢复按高水位缓冲
+  void setPrerollLead(int64_t lead_ms);
   void clear();
   void restart();
-  FrameData pop();
+  // 请求 seek：由解码线程执行，读端在下一次 readData 时丢弃旧数据
+  void seek(int64_t time_ms);
+  // 按输出采样率的帧数 seek，精确到采样
+  void seekFrame(int64_t frame);
+  // 非阻塞输入的提供方在写入新数据后调用，唤醒因 EAGAIN 等待输入的解码线程
+  void notifyInput();
+  // 每发生一次 seek 冲刷递增，读端据此重置后续滤镜状态
+  int64_t flushSerial() const;
+  // 最近一次 seek 从请求到读端拿到新数据的耗时(us)，-1 表示尚未完成
+  int64_t lastSeekLatency() const;
+  DecodeQueueStats stats() const;
   int64_t readData(uint8_t *data, int64_t size);
   int64_t readDataUntil(uint8_t *data, int64_t size);
+  // 平面格式的解码器每个声道一个环形缓冲区，按平面读取，
+  // plane_size 和返回值都是单个平面的字节数
+  int64_t readPlanarData(uint8_t *const *planes, int64_t plane_size);
+  int planes() const;
+  // 零拷贝读取(仅交错格式)：*data 指向环形缓冲区内的连续数据，返回其长度，
+  // 没有数据时与 readData 一样阻塞；处理完后 commitRead 释放空间，
+  // 两者之间不能调用其他读取函数
+  int64_t acquireRead(uint8_t **data, int64_t max_size);
+  void commitRead(int64_t size);
+  // 所有平面合计的字节数
   int64_t bytesAvailable();
+  // 当前已缓冲的时长(ms)
+  int64_t bufferedDuration();
+  int64_t highWatermarkBytes() const;
+  int64_t lowWatermarkBytes() const;
   bool aborted();
   bool canRead();
 
 private:
-  void push(FrameDataList &&items);
-  bool is_full();
+  void push(FrameDataList &items);
+  int64_t read_planes(uint8_t *const *planes, int64_t size);
+  int64_t read_rings(uint8_t *const *planes, int64_t size);
+  // 没有数据时阻塞等待，直到 read 读到数据、解码结束或中止
+  template <typename Read> int64_t read_blocking(Read &&read);
   bool is_loop_stopped();
   bool is_decode_stopped();
+  bool is_finished();
   bool is_empty();
 
+  void wait_writer(int64_t wake_level);
+  bool seek_pending();
+  void request_seek(int64_t target, bool by_frame);
+  void do_seek();
+  void flush_stale_data();
+  void wait_readable();
+  void wait_input();
+  void notify_writer();
+  void notify_reader();
+
   void decode_loop();
   void stop_loop();
 
 private:
-  FrameDataList m_frames;
-  const int64_t m_max_frames_size;
+  const int64_t m_bytes_per_second;
+  const int m_planes;
+  // 水位按单个平面的字节数计算
+  const int64_t m_high_watermark;
+  const int64_t m_low_watermark;
+  std::atomic<int64_t> m_fill_limit;
+  // 平面 0(交错格式时即全部数据)，其余平面与它同步读写
+  RingBuffer m_ring;
+  std::vector<std::unique_ptr<RingBuffer>> m_plane_rings;
+  // 仅用于等待/唤醒，读写数据本身不加锁
   std::mutex m_mutex;
   std::condition_variable m_cv_read;
   std::condition_variable m_cv_decode;
+  std::atomic<bool> m_reader_waiting;
+  std::atomic<bool> m_writer_waiting;
+  // 解码线程等待时，缓冲降到该字节数以下才唤醒
+  std::atomic<int64_t> m_writer_wake_level;
+  // 等待输入(EAGAIN)
+  std::atomic<bool> m_input_waiting;
+  std::atomic<bool> m_input_signaled;
 
   std::shared_ptr<DecoderInterface> m_decoder;
 
   std::thread m_decode_thread;
+  ThreadRole m_thread_role;
 
   std::atomic<bool> m_decode_loop_stopped;
   std::atomic<bool> m_abort;
-  std::atomic<int64_t> m_front_pos;
-  std::atomic<int64_t> m_datas_byte_size;
+
+  // seek
+  std::atomic<bool> m_seek_pending;
+  // 目标位置：m_seek_by_frame 为 true 时是帧数，否则为毫秒
+  std::atomic<int64_t> m_seek_target;
+  std::atomic<bool> m_seek_by_frame;
+  std::atomic<bool> m_flush_pending;
+  std::atomic<int64_t> m_flush_position;
+  std::atomic<int64_t> m_flush_serial;
+  std::atomic<int64_t> m_seek_request_time;
+  std::atomic<int64_t> m_last_seek_latency;
+  bool m_measure_seek;
+
+  // stats
+  std::atomic<int64_t> m_start_time;
+  std::atomic<int64_t> m_decode_idle_us;
+  std::atomic<int64_t> m_decode_wakeups;
+  std::atomic<int64_t> m_underruns;
 };
@@ -1,16 +1,37 @@
 #pragma once
-#include <list>
+#include <cstdint>
+#include <vector>
+
+struct AVBufferRef;
 
 struct FrameData {
   uint8_t *data;
   int size;
+  // 非空时 data 直接指向解码器帧缓冲(持有其引用)，无需拷贝
+  AVBufferRef *buf = nullptr;
+  // 平面格式时每个声道一个平面，依次存放在 data 中，相邻平面相隔 linesize
+  // 字节；size 为所有平面有效数据之和
+  int planes = 1;
+  int linesize = 0;
+
+  uint8_t *plane(int index) const { return data + int64_t(index) * linesize; }
+  int planeSize() const { return size / planes; }
 };
-using FrameDataList = std::list<FrameData>;
+using FrameDataList = std::vector<FrameData>;
 
 class DecoderInterface {
 public:
   virtual ~DecoderInterface() = default;
-  virtual FrameDataList decodeNextFrameData() = 0;
+  // 返回解码器持有的列表，每次调用时清空复用，稳态下不再分配；
+  // 只在下一次 decodeNextFrameData/seek 之前有效，其中的数据仍需 freeData
+  virtual FrameDataList &decodeNextFrameData() = 0;
   virtual bool isEnd() const = 0;
-  virtual void freeData(uint8_t **data) = 0;
+  virtual void freeData(FrameData &data) = 0;
+  // 输出 PCM 每秒的字节数，用于按时长计算缓冲水位
+  virtual int64_t bytesPerSecond() const = 0;
+  // 输出为平面格式时的平面数(声道数)，交错格式为 1
+  virtual int planes() const { return 1; }
+  virtual void seek(int64_t time_ms) = 0;
+  // 按输出采样率的帧数定位，避免毫秒取整带来的误差
+  virtual void seekFrame(int64_t frame) = 0;
 };
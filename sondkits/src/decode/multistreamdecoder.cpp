@@ -0,0 +1,687 @@
+#include "multistreamdecoder.h"
+#include "common.h"
+#include "gainkernels.h"
+#include "threadschedule.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+}
+
+// 每次混音输出的帧数
+static constexpr int64_t kMixFrames = 1024;
+// 混音块之外每个分轨最多缓冲的时长(毫秒)。MP4 等容器按块交织，
+// 一个分轨连续一段可达约一秒，上限太小会把仍有数据的分轨当成静音
+static constexpr int64_t kMaxBufferedMs = 2000;
+// swresample 支持的最大声道数
+static constexpr int kMaxChannels = 64;
+
+struct MultiStreamDecoder::Stem {
+  int stream_index = -1;
+  std::string name;
+  AVCodecContext *dec_ctx = nullptr;
+  SwrContext *swr_ctx = nullptr;
+  AVFrame *frame = nullptr;
+  std::thread thread;
+  std::condition_variable cv;
+  std::atomic<float> volume{1.0f};
+  // 上一个混音块结束时的音量，只在混音线程访问
+  float applied_volume = 1.0f;
+
+  // 以下成员由 m_mutex 保护
+  // nullptr 表示输入结束，需要冲刷解码器
+  std::deque<AVPacket *> packets;
+  // 每次 seek 递增，解码线程据此冲刷解码器并丢弃旧输出
+  int64_t serial = 0;
+  // seek 目标(源采样率下的采样位置)，-1 表示不需要裁剪
+  int64_t seek_target = -1;
+  bool busy = false;
+  bool finished = false;
+  bool stop = false;
+  // 已转换为目标格式、尚未混音的交错 float，环形存放：
+  // 从 output_head 开始的 output_size 个采样，容量是声道数的整数倍
+  std::vector<float> output;
+  size_t output_head = 0;
+  size_t output_size = 0;
+  // 没有数据时已补静音的帧数，之后解出的对应数据要丢弃以保持对齐
+  int64_t silence_debt = 0;
+
+  // 以下成员只在分轨解码线程访问
+  int64_t next_sample_pos = 0;
+  // 每个包的转换结果，复用以免每个包分配一次
+  std::vector<float> decoded;
+
+  int64_t availableFrames(int channels) const {
+    return int64_t(output_size) / channels;
+  }
+
+  void clearOutput() {
+    output_head = 0;
+    output_size = 0;
+  }
+
+  // 空间不足时按倍数扩容并把数据整理到开头
+  void pushOutput(const float *data, size_t count, int channels) {
+    if (output_size + count > output.size()) {
+      size_t capacity = std::max(output.size() * 2, output_size + count);
+      capacity = (capacity + channels - 1) / channels * channels;
+      std::vector<float> grown(capacity);
+      readOutput(grown.data(), output_size);
+      output.swap(grown);
+      output_head = 0;
+    }
+    size_t tail = (output_head + output_size) % output.size();
+    size_t first = std::min(count, output.size() - tail);
+    std::copy(data, data + first, output.begin() + tail);
+    std::copy(data + first, data + count, output.begin());
+    output_size += count;
+  }
+
+  // 拷贝出开头 count 个采样，不移动读位置
+  void readOutput(float *dst, size_t count) const {
+    size_t first = std::min(count, output.size() - output_head);
+    std::copy(output.begin() + output_head,
+              output.begin() + output_head + first, dst);
+    std::copy(output.begin(), output.begin() + (count - first), dst + first);
+  }
+
+  void consumeOutput(size_t count) {
+    output_head = (output_head + count) % output.size();
+    output_size -= count;
+  }
+};
+
+template <typename T>
+static void floatToInteger(T *dst, const float *src, int64_t count) {
+  const double scale = double(std::numeric_limits<T>::max()) + 1.0;
+  for (int64_t i = 0; i < count; ++i) {
+    double v = double(src[i]) * scale;
+    v = std::clamp<double>(v, std::numeric_limits<T>::lowest(),
+                           std::numeric_limits<T>::max());
+    dst[i] = static_cast<T>(v);
+  }
+}
+
+MultiStreamDecoder::MultiStreamDecoder(int target_sample_rate,
+                                       int target_channels,
+                                       AVSampleFormat target_sample_format)
+    : m_target_sample_rate(target_sample_rate),
+      m_target_channels(target_channels),
+      m_target_sample_format(target_sample_format), m_fmt_ctx(nullptr),
+      m_demux_end(false), m_is_end(false) {
+  if (target_sample_format != AV_SAMPLE_FMT_FLT &&
+      target_sample_format != AV_SAMPLE_FMT_S16 &&
+      target_sample_format != AV_SAMPLE_FMT_S32) {
+    throw std::runtime_error("Unsupported mix output format");
+  }
+  if (target_sample_rate <= 0 || target_channels <= 0 ||
+      target_channels > kMaxChannels) {
+    throw std::runtime_error("Invalid mix output layout");
+  }
+}
+
+MultiStreamDecoder::~MultiStreamDecoder() { close(); }
+
+int MultiStreamDecoder::audioStreamCount(const AVFormatContext *fmt_ctx) {
+  if (!fmt_ctx) {
+    return 0;
+  }
+  int count = 0;
+  for (unsigned i = 0; i < fmt_ctx->nb_streams; i++) {
+    if (fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void MultiStreamDecoder::open(const std::filesystem::path &in_fpath,
+                              const std::vector<int> &stream_indexes) {
+  int ret = 0;
+  if ((ret = avformat_open_input(&m_fmt_ctx, in_fpath.u8string().c_str(),
+                                 nullptr, nullptr)) < 0) {
+    throw std::runtime_error("[avformat_open_input]Could not open input file:" +
+                             avErr2String(ret));
+  }
+  if ((ret = avformat_find_stream_info(m_fmt_ctx, nullptr)) < 0) {
+    throw std::runtime_error("[avformat_find_stream_info]Failed to retrieve "
+                             "input stream information");
+  }
+
+  std::vector<int> indexes = stream_indexes;
+  if (indexes.empty()) {
+    for (unsigned i = 0; i < m_fmt_ctx->nb_streams; i++) {
+      if (m_fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+        indexes.push_back((int)i);
+      }
+    }
+  }
+  if (indexes.empty()) {
+    throw std::runtime_error("Could not find audio stream in the input file");
+  }
+  // 不解码的流在解复用时直接丢弃
+  for (unsigned i = 0; i < m_fmt_ctx->nb_streams; i++) {
+    m_fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+  }
+  for (auto index : indexes) {
+    openStem(index);
+  }
+
+  m_demux_end = false;
+  m_is_end = false;
+  m_mix_buffer.assign(kMixFrames * m_target_channels, 0.0f);
+  m_buffer_pool.reserve(kMixFrames * m_target_channels *
+                        av_get_bytes_per_sample(m_target_sample_format));
+
+  for (auto &stem : m_stems) {
+    auto p = stem.get();
+    stem->thread = std::thread([this, p]() { stem_loop(p); });
+  }
+}
+
+void MultiStreamDecoder::openStem(int stream_index) {
+  if (stream_index < 0 || stream_index >= (int)m_fmt_ctx->nb_streams) {
+    throw std::runtime_error("Invalid stream index: " +
+                             std::to_string(stream_index));
+  }
+  AVStream *stream = m_fmt_ctx->streams[stream_index];
+  if (stream->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
+    throw std::runtime_error("Not an audio stream: " +
+                             std::to_string(stream_index));
+  }
+  stream->discard = AVDISCARD_DEFAULT;
+
+  auto stem = std::make_unique<Stem>();
+  stem->stream_index = stream_index;
+  auto title = av_dict_get(stream->metadata, "title", nullptr, 0);
+  if (!title) {
+    title = av_dict_get(stream->metadata, "handler_name", nullptr, 0);
+  }
+  stem->name = title ? title->value : "stream " + std::to_string(stream_index);
+
+  const AVCodec *decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (!decoder) {
+    throw std::runtime_error("Failed to find decoder for codec ID: " +
+                             std::to_string(stream->codecpar->codec_id));
+  }
+  stem->dec_ctx = avcodec_alloc_context3(decoder);
+  if (!stem->dec_ctx) {
+    throw std::runtime_error("Failed to allocate the decoder context");
+  }
+  // 先加入列表，出错时由 close 统一释放
+  auto p = stem.get();
+  m_stems.push_back(std::move(stem));
+
+  if (avcodec_parameters_to_context(p->dec_ctx, stream->codecpar) < 0) {
+    throw std::runtime_error(
+        "Failed to copy decoder parameters to input decoder context");
+  }
+  p->dec_ctx->pkt_timebase = stream->time_base;
+  int ret = avcodec_open2(p->dec_ctx, decoder, nullptr);
+  if (ret < 0) {
+    throw std::runtime_error(
+        "[avcodec_open2]Failed to open decoder for stream #" +
+        std::to_string(stream_index) + ": " + avErr2String(ret));
+  }
+
+  // 每个分轨都重采样到统一的交错 float，方便求和
+  AVChannelLayout out_ch_layout;
+  av_channel_layout_default(&out_ch_layout, m_target_channels);
+  ret = swr_alloc_set_opts2(&p->swr_ctx, &out_ch_layout, AV_SAMPLE_FMT_FLT,
+                            m_target_sample_rate, &p->dec_ctx->ch_layout,
+                            p->dec_ctx->sample_fmt, p->dec_ctx->sample_rate, 0,
+                            nullptr);
+  if (ret < 0 || (ret = swr_init(p->swr_ctx)) < 0) {
+    throw std::runtime_error("Failed to initialize resampler: " +
+                             avErr2String(ret));
+  }
+  p->frame = av_frame_alloc();
+  if (!p->frame) {
+    throw std::runtime_error("Failed to allocate frame");
+  }
+}
+
+void MultiStreamDecoder::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &stem : m_stems) {
+      stem->stop = true;
+      stem->cv.notify_all();
+    }
+  }
+  for (auto &stem : m_stems) {
+    if (stem->thread.joinable()) {
+      stem->thread.join();
+    }
+    for (auto packet : stem->packets) {
+      av_packet_free(&packet);
+    }
+    stem->packets.clear();
+    if (stem->dec_ctx) {
+      avcodec_free_context(&stem->dec_ctx);
+    }
+    if (stem->swr_ctx) {
+      swr_free(&stem->swr_ctx);
+    }
+    if (stem->frame) {
+      av_frame_free(&stem->frame);
+    }
+  }
+  m_stems.clear();
+  for (auto packet : m_free_packets) {
+    av_packet_free(&packet);
+  }
+  m_free_packets.clear();
+  if (m_fmt_ctx) {
+    avformat_close_input(&m_fmt_ctx);
+  }
+}
+
+// 分轨解码线程：取包、解码、重采样，结果追加到分轨输出
+void MultiStreamDecoder::stem_loop(Stem *stem) {
+  promoteCurrentThread(ThreadRole::Decode);
+  int64_t serial = 0;
+  while (true) {
+    AVPacket *packet = nullptr;
+    bool flush = false;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      stem->cv.wait(lock,
+                    [stem]() { return stem->stop || !stem->packets.empty(); });
+      if (stem->stop) {
+        break;
+      }
+      packet = stem->packets.front();
+      stem->packets.pop_front();
+      if (serial != stem->serial) {
+        serial = stem->serial;
+        flush = true;
+      }
+      stem->busy = true;
+    }
+    if (flush) {
+      avcodec_flush_buffers(stem->dec_ctx);
+      // 重新初始化以清空重采样器内部缓存的采样
+      swr_init(stem->swr_ctx);
+      stem->next_sample_pos = 0;
+    }
+    decode_packet(stem, packet, serial);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (packet) {
+        release_packet_locked(packet);
+      }
+      stem->busy = false;
+    }
+    m_cv_mix.notify_all();
+  }
+}
+
+void MultiStreamDecoder::decode_packet(Stem *stem, AVPacket *packet,
+                                       int64_t serial) {
+  auto &out = stem->decoded;
+  out.clear();
+  int ret = avcodec_send_packet(stem->dec_ctx, packet);
+  if (ret < 0 && ret != AVERROR_EOF) {
+    std::cerr << "Error sending packet to stem " << stem->stream_index << ": "
+              << avErr2String(ret) << std::endl;
+  }
+  while (ret >= 0 || ret == AVERROR_EOF) {
+    ret = avcodec_receive_frame(stem->dec_ctx, stem->frame);
+    if (ret < 0) {
+      break;
+    }
+    convert_frame(stem, stem->frame, serial, out);
+    av_frame_unref(stem->frame);
+  }
+  if (!packet) {
+    // 输入结束：取出重采样器中剩余的采样
+    int out_samples = swr_get_out_samples(stem->swr_ctx, 0);
+    if (out_samples > 0) {
+      size_t old_size = out.size();
+      out.resize(old_size + (size_t)out_samples * m_target_channels);
+      auto dst = reinterpret_cast<uint8_t *>(out.data() + old_size);
+      int num = swr_convert(stem->swr_ctx, &dst, out_samples, nullptr, 0);
+      out.resize(old_size + (size_t)std::max(num, 0) * m_target_channels);
+    }
+  }
+  append_output(stem, out, serial);
+  if (!packet) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (serial == stem->serial) {
+      stem->finished = true;
+    }
+  }
+}
+
+void MultiStreamDecoder::convert_frame(Stem *stem, AVFrame *frame,
+                                       int64_t serial,
+                                       std::vector<float> &out) {
+  const int sample_rate = stem->dec_ctx->sample_rate;
+  int64_t pos = stem->next_sample_pos;
+  if (frame->best_effort_timestamp != AV_NOPTS_VALUE) {
+    AVStream *stream = m_fmt_ctx->streams[stem->stream_index];
+    int64_t start =
+        stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    pos = av_rescale_q(frame->best_effort_timestamp - start,
+                       stem->dec_ctx->pkt_timebase, AVRational{1, sample_rate});
+  }
+  stem->next_sample_pos = pos + frame->nb_samples;
+
+  // seek 后丢弃目标位置之前的采样；已过期的旧数据不转换
+  int skip = 0;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (serial != stem->serial) {
+      return;
+    }
+    if (stem->seek_target >= 0) {
+      if (stem->next_sample_pos <= stem->seek_target) {
+        return;
+      }
+      skip = (int)std::max<int64_t>(stem->seek_target - pos, 0);
+      stem->seek_target = -1;
+    }
+  }
+
+  const int channels = frame->ch_layout.nb_channels;
+  const int bytes_per_sample =
+      av_get_bytes_per_sample((AVSampleFormat)frame->format);
+  const uint8_t *in_data[kMaxChannels] = {nullptr};
+  if (av_sample_fmt_is_planar((AVSampleFormat)frame->format)) {
+    for (int i = 0; i < channels && i < kMaxChannels; i++) {
+      in_data[i] = frame->extended_data[i] + skip * bytes_per_sample;
+    }
+  } else {
+    in_data[0] = frame->data[0] + skip * bytes_per_sample * channels;
+  }
+  const int nb_samples = frame->nb_samples - skip;
+  int out_samples = swr_get_out_samples(stem->swr_ctx, nb_samples);
+  if (out_samples <= 0) {
+    return;
+  }
+  size_t old_size = out.size();
+  out.resize(old_size + (size_t)out_samples * m_target_channels);
+  auto dst = reinterpret_cast<uint8_t *>(out.data() + old_size);
+  int num = swr_convert(stem->swr_ctx, &dst, out_samples, in_data, nb_samples);
+  if (num < 0) {
+    std::cerr << "Error converting frame: " << avErr2String(num) << std::endl;
+  }
+  out.resize(old_size + (size_t)std::max(num, 0) * m_target_channels);
+}
+
+void MultiStreamDecoder::append_output(Stem *stem,
+                                       const std::vector<float> &out,
+                                       int64_t serial) {
+  if (out.empty()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // seek 之后才解出的旧数据直接丢弃
+  if (serial != stem->serial) {
+    return;
+  }
+  size_t skip = std::min<size_t>(
+      size_t(stem->silence_debt) * m_target_channels, out.size());
+  stem->silence_debt -= int64_t(skip) / m_target_channels;
+  stem->pushOutput(out.data() + skip, out.size() - skip, m_target_channels);
+}
+
+AVPacket *MultiStreamDecoder::acquire_packet() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_free_packets.empty()) {
+      auto packet = m_free_packets.back();
+      m_free_packets.pop_back();
+      return packet;
+    }
+  }
+  return av_packet_alloc();
+}
+
+void MultiStreamDecoder::release_packet_locked(AVPacket *packet) {
+  av_packet_unref(packet);
+  m_free_packets.push_back(packet);
+}
+
+// 直接读进复用的包再交给分轨，不再克隆
+int MultiStreamDecoder::demux_one() {
+  AVPacket *packet = acquire_packet();
+  if (!packet) {
+    return AVERROR(ENOMEM);
+  }
+  int ret = av_read_frame(m_fmt_ctx, packet);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (ret < 0) {
+    release_packet_locked(packet);
+    return ret;
+  }
+  for (auto &stem : m_stems) {
+    if (stem->stream_index == packet->stream_index) {
+      stem->packets.push_back(packet);
+      stem->cv.notify_one();
+      return 0;
+    }
+  }
+  release_packet_locked(packet);
+  return 0;
+}
+
+// 等到每个仍在解码的分轨都攒够一个混音块再求和；
+// 只有输出最少的分轨没有待解码的包时才继续解复用。任一分轨的缓冲达到
+// 上限时不再解复用，最慢的分轨在这段时间没有包，按静音混音
+FrameDataList &MultiStreamDecoder::decodeNextFrameData() {
+  auto &frame_data_list = m_frame_data_list;
+  frame_data_list.clear();
+  if (m_is_end || m_stems.empty()) {
+    return frame_data_list;
+  }
+
+  const int64_t buffer_cap =
+      kMixFrames + m_target_sample_rate * kMaxBufferedMs / 1000;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    Stem *lagging = nullptr;
+    int64_t ready = std::numeric_limits<int64_t>::max();
+    int64_t remaining = 0;
+    int64_t most = 0;
+    for (auto &stem : m_stems) {
+      auto available = stem->availableFrames(m_target_channels);
+      remaining = std::max(remaining, available);
+      if (!stem->finished) {
+        most = std::max(most, available);
+      }
+      if (!stem->finished && available < ready) {
+        ready = available;
+        lagging = stem.get();
+      }
+    }
+    if (!lagging) {
+      // 所有分轨都已结束，输出剩余采样，较短的分轨补静音
+      if (remaining <= 0) {
+        m_is_end = true;
+        break;
+      }
+      frame_data_list.push_back(mix(std::min(remaining, kMixFrames)));
+      break;
+    }
+    if (ready >= kMixFrames) {
+      frame_data_list.push_back(mix(kMixFrames));
+      break;
+    }
+    if (lagging->busy || !lagging->packets.empty() || m_demux_end) {
+      m_cv_mix.wait(lock);
+      continue;
+    }
+    if (most >= buffer_cap) {
+      frame_data_list.push_back(mix(kMixFrames));
+      break;
+    }
+    lock.unlock();
+    int ret = demux_one();
+    lock.lock();
+    if (ret == AVERROR(EAGAIN)) {
+      // 非阻塞输入暂时没有数据，返回空列表由调用方等待
+      break;
+    }
+    if (ret < 0) {
+      if (ret != AVERROR_EOF) {
+        // 读错误按文件结束处理
+        std::cerr << "Error reading packet: " << avErr2String(ret) << std::endl;
+      }
+      m_demux_end = true;
+      for (auto &stem : m_stems) {
+        stem->packets.push_back(nullptr);
+        stem->cv.notify_one();
+      }
+    }
+  }
+  return frame_data_list;
+}
+
+// 在持有 m_mutex 时调用
+FrameData MultiStreamDecoder::mix(int64_t frames) {
+  const int64_t count = frames * m_target_channels;
+  const int64_t size =
+      count * av_get_bytes_per_sample(m_target_sample_format);
+  uint8_t *pdata = m_buffer_pool.acquire(size);
+  if (!pdata) {
+    return FrameData{nullptr, 0};
+  }
+  // float 输出直接在输出缓冲上求和
+  float *acc = m_target_sample_format == AV_SAMPLE_FMT_FLT
+                   ? reinterpret_cast<float *>(pdata)
+                   : m_mix_buffer.data();
+  std::fill(acc, acc + count, 0.0f);
+
+  for (auto &stem : m_stems) {
+    const float gain_to = stem->volume.load();
+    const float gain_from = stem->applied_volume;
+    auto available = std::min(frames, stem->availableFrames(m_target_channels));
+    if (!stem->finished && available < frames) {
+      // 仍在解码的分轨数据不足时补静音
+      stem->silence_debt += frames - available;
+    }
+    if (available <= 0) {
+      continue;
+    }
+    // 音量在整块内线性过渡，避免调节时产生爆音；较短的块按整块的
+    // 曲线截取，只走到中途时下一块从截止处的音量继续
+    const float step = (gain_to - gain_from) / frames;
+    const float gain_end =
+        available == frames ? gain_to : gain_from + step * available;
+    // 环形输出回绕时分两段，第二段接着第一段的音量
+    int64_t first = std::min<int64_t>(
+        available, (stem->output.size() - stem->output_head) /
+                       m_target_channels);
+    const float gain_mid =
+        first == available ? gain_end : gain_from + step * first;
+    mixGainRamp(acc, stem->output.data() + stem->output_head, first,
+                m_target_channels, gain_from, gain_mid);
+    if (first < available) {
+      mixGainRamp(acc + first * m_target_channels, stem->output.data(),
+                  available - first, m_target_channels, gain_mid, gain_end);
+    }
+    stem->consumeOutput(available * m_target_channels);
+    stem->applied_volume = gain_end;
+  }
+
+  if (m_target_sample_format == AV_SAMPLE_FMT_S16) {
+    floatToInteger(reinterpret_cast<int16_t *>(pdata), acc, count);
+  } else if (m_target_sample_format == AV_SAMPLE_FMT_S32) {
+    floatToInteger(reinterpret_cast<int32_t *>(pdata), acc, count);
+  }
+  return FrameData{pdata, (int)size};
+}
+
+bool MultiStreamDecoder::isEnd() const { return m_is_end; }
+
+void MultiStreamDecoder::freeData(FrameData &data) {
+  if (data.data) {
+    m_buffer_pool.release(data.data);
+  }
+  data.data = nullptr;
+  data.size = 0;
+}
+
+int64_t MultiStreamDecoder::bytesPerSecond() const {
+  return int64_t(m_target_sample_rate) * m_target_channels *
+         av_get_bytes_per_sample(m_target_sample_format);
+}
+
+// 在解码线程(与 decodeNextFrameData 相同)调用
+void MultiStreamDecoder::seek(int64_t time_ms) { seek_position(time_ms, 1000); }
+
+void MultiStreamDecoder::seekFrame(int64_t frame) {
+  seek_position(frame, m_target_sample_rate);
+}
+
+// 定位到 pos / rate 秒，各分轨按自己的采样率换算丢弃的目标位置
+void MultiStreamDecoder::seek_position(int64_t pos, int rate) {
+  if (!m_fmt_ctx) {
+    return;
+  }
+  pos = std::max<int64_t>(pos, 0);
+  int64_t ts = av_rescale(pos, AV_TIME_BASE, rate);
+  if (m_fmt_ctx->start_time != AV_NOPTS_VALUE) {
+    ts += m_fmt_ctx->start_time;
+  }
+  int ret = av_seek_frame(m_fmt_ctx, -1, ts, AVSEEK_FLAG_BACKWARD);
+  if (ret < 0) {
+    std::cerr << "Error seeking: " << avErr2String(ret) << std::endl;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &stem : m_stems) {
+    for (auto packet : stem->packets) {
+      if (packet) {
+        release_packet_locked(packet);
+      }
+    }
+    stem->packets.clear();
+    stem->clearOutput();
+    stem->silence_debt = 0;
+    stem->finished = false;
+    stem->serial++;
+    stem->seek_target = av_rescale(pos, stem->dec_ctx->sample_rate, rate);
+  }
+  m_demux_end = false;
+  m_is_end = false;
+}
+
+double MultiStreamDecoder::duration() const {
+  if (!m_fmt_ctx || m_fmt_ctx->duration == AV_NOPTS_VALUE) {
+    return 0;
+  }
+  return double(m_fmt_ctx->duration) / AV_TIME_BASE;
+}
+
+int MultiStreamDecoder::stemCount() const { return (int)m_stems.size(); }
+
+std::string MultiStreamDecoder::stemName(int stem) const {
+  if (stem < 0 || stem >= stemCount()) {
+    return std::string();
+  }
+  return m_stems[stem]->name;
+}
+
+void MultiStreamDecoder::setStemVolume(int stem, float volume) {
+  if (stem < 0 || stem >= stemCount()) {
+    return;
+  }
+  m_stems[stem]->volume.store(std::clamp(volume, 0.0f, 1.0f));
+}
+
+float MultiStreamDecoder::stemVolume(int stem) const {
+  if (stem < 0 || stem >= stemCount()) {
+    return 0;
+  }
+  return m_stems[stem]->volume.load();
+}
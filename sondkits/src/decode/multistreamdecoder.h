@@ -0,0 +1,88 @@
+#pragma once
+
+#include "bufferpool.h"
+#include "decoder.h"
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswresample/swresample.h>
+}
+
+// 多音轨(分轨)容器的解码与混音：
+// 只解复用一次，每条音频流一个解码上下文和解码线程，
+// 各分轨重采样为目标采样率/声道的 float 后按分轨音量求和，输出目标格式
+class MultiStreamDecoder : public DecoderInterface {
+public:
+  // 目标格式支持交错的 FLT/S16/S32
+  MultiStreamDecoder(int target_sample_rate, int target_channels,
+                     AVSampleFormat target_sample_format);
+  ~MultiStreamDecoder() override;
+  MultiStreamDecoder(const MultiStreamDecoder &) = delete;
+  MultiStreamDecoder &operator=(const MultiStreamDecoder &) = delete;
+
+  // stream_indexes 为空时解码所有音频流
+  void open(const std::filesystem::path &in_fpath,
+            const std::vector<int> &stream_indexes = {});
+  void close();
+  FrameDataList &decodeNextFrameData() override;
+  bool isEnd() const override;
+  void freeData(FrameData &data) override;
+  int64_t bytesPerSecond() const override;
+  void seek(int64_t time_ms) override;
+  void seekFrame(int64_t frame) override;
+
+  double duration() const;
+  int stemCount() const;
+  std::string stemName(int stem) const;
+  // 可在任意线程调用，下一个混音块内平滑过渡到新音量
+  void setStemVolume(int stem, float volume);
+  float stemVolume(int stem) const;
+
+  // 文件中音频流的数量，用于决定是否需要多轨解码
+  static int audioStreamCount(const AVFormatContext *fmt_ctx);
+
+private:
+  struct Stem;
+
+  void openStem(int stream_index);
+  void stem_loop(Stem *stem);
+  void decode_packet(Stem *stem, AVPacket *packet, int64_t serial);
+  void convert_frame(Stem *stem, AVFrame *frame, int64_t serial,
+                     std::vector<float> &out);
+  void append_output(Stem *stem, const std::vector<float> &out,
+                     int64_t serial);
+  // 读一个包并分发给对应分轨，返回 av_read_frame 的结果
+  int demux_one();
+  // 包在解复用和分轨解码线程之间循环使用，不再每个包分配一次
+  AVPacket *acquire_packet();
+  // 在持有 m_mutex 时调用
+  void release_packet_locked(AVPacket *packet);
+  FrameData mix(int64_t frames);
+  void seek_position(int64_t pos, int rate);
+
+private:
+  const int m_target_sample_rate;
+  const int m_target_channels;
+  const AVSampleFormat m_target_sample_format;
+
+  AVFormatContext *m_fmt_ctx;
+  std::vector<std::unique_ptr<Stem>> m_stems;
+  BufferPool m_buffer_pool;
+  FrameDataList m_frame_data_list;
+  std::vector<float> m_mix_buffer;
+
+  // 保护各分轨的包队列和输出
+  std::mutex m_mutex;
+  // 已解引用、可复用的空包
+  std::vector<AVPacket *> m_free_packets;
+  std::condition_variable m_cv_mix;
+  bool m_demux_end;
+  bool m_is_end;
+};
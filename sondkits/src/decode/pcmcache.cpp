@@ -0,0 +1,548 @@
+#include "pcmcache.h"
+#include "audiodecoder.h"
+#include "common.h"
+#include "threadschedule.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+static const char kPCMCacheMagic[4] = {'S', 'K', 'P', 'C'};
+static const uint32_t kPCMCacheVersion = 1;
+// 磁盘缓存文件中 PCM 数据的起始偏移按此对齐
+static const int64_t kPCMDataAlign = 64;
+
+template <typename T> static void writePod(std::ostream &out, T v) {
+  out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T>
+static bool readPod(const uint8_t *data, int64_t size, int64_t *offset, T *v) {
+  if (*offset + static_cast<int64_t>(sizeof(T)) > size) {
+    return false;
+  }
+  memcpy(v, data + *offset, sizeof(T));
+  *offset += sizeof(T);
+  return true;
+}
+
+PCMTrack::PCMTrack(int sample_rate, int channels, AVSampleFormat format,
+                   std::vector<uint8_t> pcm)
+    : m_sample_rate(sample_rate), m_channels(channels), m_format(format),
+      m_pcm(std::move(pcm)), m_data(m_pcm.data()),
+      m_size(static_cast<int64_t>(m_pcm.size())) {}
+
+PCMTrack::PCMTrack(int sample_rate, int channels, AVSampleFormat format,
+                   std::unique_ptr<MappedFile> file, int64_t offset,
+                   int64_t size)
+    : m_sample_rate(sample_rate), m_channels(channels), m_format(format),
+      m_file(std::move(file)), m_data(m_file->data() + offset), m_size(size) {
+}
+
+const uint8_t *PCMTrack::data() const { return m_data; }
+
+int64_t PCMTrack::size() const { return m_size; }
+
+int PCMTrack::sampleRate() const { return m_sample_rate; }
+
+int PCMTrack::channels() const { return m_channels; }
+
+AVSampleFormat PCMTrack::format() const { return m_format; }
+
+int PCMTrack::frameSize() const {
+  return m_channels * av_get_bytes_per_sample(m_format);
+}
+
+int64_t PCMTrack::bytesPerSecond() const {
+  return int64_t(m_sample_rate) * frameSize();
+}
+
+bool PCMTrack::mapped() const { return m_file != nullptr; }
+
+PCMCache::PCMCache(int64_t memory_budget)
+    : m_memory_budget(memory_budget), m_memory_usage(0),
+      m_recording_usage(0), m_stop(false) {}
+
+// 尚未写入的曲目直接丢弃，下次打开时重新解码
+PCMCache::~PCMCache() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_save_cv.notify_all();
+  }
+  if (m_save_thread.joinable()) {
+    m_save_thread.join();
+  }
+}
+
+PCMCache &PCMCache::instance() {
+  static PCMCache cache;
+  return cache;
+}
+
+std::string PCMCache::make_key(const std::filesystem::path &media_path,
+                               int sample_rate, int channels,
+                               AVSampleFormat format) {
+  return media_path.u8string() + "|" + std::to_string(sample_rate) + "|" +
+         std::to_string(channels) + "|" + std::to_string(format);
+}
+
+std::shared_ptr<const PCMTrack>
+PCMCache::find(const std::filesystem::path &media_path, int sample_rate,
+               int channels, AVSampleFormat format) {
+  Item item;
+  if (!mediaFileKey(media_path, &item.file_size, &item.mtime)) {
+    return nullptr;
+  }
+  item.key = make_key(media_path, sample_rate, channels, format);
+  item.path = media_path.u8string();
+
+  std::filesystem::path dir;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(item.key);
+    if (it != m_index.end()) {
+      auto cached = it->second;
+      if (cached->file_size == item.file_size && cached->mtime == item.mtime) {
+        m_items.splice(m_items.begin(), m_items, cached);
+        return cached->track;
+      }
+      // 文件已被修改
+      m_memory_usage -= cached->track->size();
+      m_items.erase(cached);
+      m_index.erase(it);
+    }
+    dir = m_disk_dir;
+  }
+  if (dir.empty()) {
+    return nullptr;
+  }
+  // 磁盘层的映射和校验不持锁
+  item.track = load_disk(dir, item, sample_rate, channels, format);
+  if (!item.track) {
+    return nullptr;
+  }
+  auto track = item.track;
+  put(std::move(item));
+  return track;
+}
+
+std::shared_ptr<const PCMTrack> PCMCache::find(const AudioDecoder &decoder) {
+  if (decoder.path().empty() || decoder.byteSource()) {
+    return nullptr;
+  }
+  return find(decoder.path(), decoder.targetSampleRate(),
+              decoder.targetChannels(), decoder.targetSampleFormat());
+}
+
+std::shared_ptr<const PCMTrack>
+PCMCache::insert(const std::filesystem::path &media_path, int sample_rate,
+                 int channels, AVSampleFormat format,
+                 std::vector<uint8_t> pcm) {
+  Item item;
+  if (pcm.empty() ||
+      !mediaFileKey(media_path, &item.file_size, &item.mtime)) {
+    return nullptr;
+  }
+  item.key = make_key(media_path, sample_rate, channels, format);
+  item.path = media_path.u8string();
+  item.track = std::make_shared<const PCMTrack>(sample_rate, channels, format,
+                                                std::move(pcm));
+  auto track = item.track;
+  auto dir = diskCacheDir();
+  if (!dir.empty()) {
+    schedule_save(dir, item);
+  }
+  put(std::move(item));
+  return track;
+}
+
+void PCMCache::schedule_save(const std::filesystem::path &dir,
+                             const Item &item) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_stop) {
+    return;
+  }
+  m_save_queue.emplace_back(dir, item);
+  if (!m_save_thread.joinable()) {
+    m_save_thread = std::thread(&PCMCache::save_loop, this);
+  }
+  m_save_cv.notify_one();
+}
+
+void PCMCache::save_loop() {
+  promoteCurrentThread(ThreadRole::Worker);
+  while (true) {
+    std::pair<std::filesystem::path, Item> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_save_cv.wait(lock,
+                     [this]() { return m_stop || !m_save_queue.empty(); });
+      if (m_stop) {
+        break;
+      }
+      task = std::move(m_save_queue.front());
+      m_save_queue.pop_front();
+    }
+    save_disk(task.first, task.second);
+  }
+}
+
+void PCMCache::put(Item item) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // 单曲超过整个预算时不进入内存层
+  if (item.track->size() > m_memory_budget) {
+    return;
+  }
+  auto it = m_index.find(item.key);
+  if (it != m_index.end()) {
+    m_memory_usage -= it->second->track->size();
+    m_items.erase(it->second);
+    m_index.erase(it);
+  }
+  m_memory_usage += item.track->size();
+  m_items.push_front(std::move(item));
+  m_index[m_items.front().key] = m_items.begin();
+  evict();
+}
+
+void PCMCache::evict() {
+  while (m_memory_usage + m_recording_usage > m_memory_budget &&
+         !m_items.empty()) {
+    m_memory_usage -= m_items.back().track->size();
+    m_index.erase(m_items.back().key);
+    m_items.pop_back();
+  }
+}
+
+void PCMCache::remove(const std::filesystem::path &media_path) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto path = media_path.u8string();
+  for (auto it = m_items.begin(); it != m_items.end();) {
+    if (it->path == path) {
+      m_memory_usage -= it->track->size();
+      m_index.erase(it->key);
+      it = m_items.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void PCMCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_items.clear();
+  m_index.clear();
+  m_memory_usage = 0;
+}
+
+bool PCMCache::reserveRecording(int64_t bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_recording_usage + bytes > m_memory_budget) {
+    return false;
+  }
+  m_recording_usage += bytes;
+  evict();
+  return true;
+}
+
+void PCMCache::releaseRecording(int64_t bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_recording_usage = std::max<int64_t>(m_recording_usage - bytes, 0);
+}
+
+void PCMCache::setMemoryBudget(int64_t bytes) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_memory_budget = std::max<int64_t>(bytes, 0);
+  evict();
+}
+
+int64_t PCMCache::memoryBudget() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_memory_budget;
+}
+
+int64_t PCMCache::memoryUsage() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_memory_usage;
+}
+
+void PCMCache::setDiskCacheDir(const std::filesystem::path &dir) {
+  if (!dir.empty()) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_disk_dir = dir;
+}
+
+std::filesystem::path PCMCache::diskCacheDir() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_disk_dir;
+}
+
+// 文件名取键的哈希，冲突时由文件头中保存的完整键区分
+std::filesystem::path PCMCache::disk_path(const std::filesystem::path &dir,
+                                          const std::string &key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.pcm",
+           static_cast<unsigned long long>(std::hash<std::string>()(key)));
+  return dir / name;
+}
+
+// 文件头：magic、版本、源文件大小和修改时间、格式、PCM 字节数、键，
+// 之后按 kPCMDataAlign 对齐存放原始 PCM
+bool PCMCache::save_disk(const std::filesystem::path &dir, const Item &item) {
+  auto path = disk_path(dir, item.key);
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      return false;
+    }
+    const auto &track = item.track;
+    out.write(kPCMCacheMagic, sizeof(kPCMCacheMagic));
+    writePod(out, kPCMCacheVersion);
+    writePod(out, item.file_size);
+    writePod(out, item.mtime);
+    writePod(out, static_cast<int32_t>(track->sampleRate()));
+    writePod(out, static_cast<int32_t>(track->channels()));
+    writePod(out, static_cast<int32_t>(track->format()));
+    writePod(out, track->size());
+    writePod(out, static_cast<uint32_t>(item.key.size()));
+    out.write(item.key.data(), item.key.size());
+    int64_t header_size = out.tellp();
+    auto padding = (kPCMDataAlign - header_size % kPCMDataAlign);
+    for (int64_t i = 0; i < padding % kPCMDataAlign; i++) {
+      out.put(0);
+    }
+    out.write(reinterpret_cast<const char *>(track->data()), track->size());
+    if (!out) {
+      out.close();
+      std::error_code ec;
+      std::filesystem::remove(tmp_path, ec);
+      std::cerr << "Failed to write pcm cache: " << path.u8string()
+                << std::endl;
+      return false;
+    }
+  }
+  // 先写临时文件再改名，其他进程不会映射到写了一半的文件
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec;
+}
+
+std::shared_ptr<const PCMTrack>
+PCMCache::load_disk(const std::filesystem::path &dir, const Item &item,
+                    int sample_rate, int channels, AVSampleFormat format) {
+  std::unique_ptr<MappedFile> file;
+  try {
+    file = std::make_unique<MappedFile>(disk_path(dir, item.key));
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+  const uint8_t *data = file->data();
+  const int64_t size = file->size();
+  int64_t offset = sizeof(kPCMCacheMagic);
+  uint32_t version = 0, key_size = 0;
+  int64_t file_size = 0, mtime = 0, pcm_size = 0;
+  int32_t rate = 0, nb_channels = 0, fmt = 0;
+  if (size < offset || memcmp(data, kPCMCacheMagic, offset) != 0 ||
+      !readPod(data, size, &offset, &version) || version != kPCMCacheVersion ||
+      !readPod(data, size, &offset, &file_size) ||
+      !readPod(data, size, &offset, &mtime) ||
+      !readPod(data, size, &offset, &rate) ||
+      !readPod(data, size, &offset, &nb_channels) ||
+      !readPod(data, size, &offset, &fmt) ||
+      !readPod(data, size, &offset, &pcm_size) ||
+      !readPod(data, size, &offset, &key_size) ||
+      offset + int64_t(key_size) > size) {
+    return nullptr;
+  }
+  std::string key(reinterpret_cast<const char *>(data + offset), key_size);
+  offset += key_size;
+  offset += (kPCMDataAlign - offset % kPCMDataAlign) % kPCMDataAlign;
+  if (key != item.key || file_size != item.file_size || mtime != item.mtime ||
+      rate != sample_rate || nb_channels != channels || fmt != format ||
+      pcm_size <= 0 || offset + pcm_size > size) {
+    // 源文件已变化或哈希冲突
+    return nullptr;
+  }
+  file->adviseAccess(MappedFile::Access::Sequential);
+  return std::make_shared<const PCMTrack>(sample_rate, channels, format,
+                                          std::move(file), offset, pcm_size);
+}
+
+PCMCacheDecoder::PCMCacheDecoder(std::shared_ptr<AudioDecoder> decoder)
+    : m_decoder(decoder), m_pos(0), m_chunk_size(0), m_recording(false),
+      m_record_expected(0), m_record_reserved(0) {
+  if (!m_decoder) {
+    throw std::runtime_error("PCMCacheDecoder requires a decoder");
+  }
+  const int frame_size =
+      m_decoder->targetChannels() *
+      av_get_bytes_per_sample(m_decoder->targetSampleFormat());
+  // 命中时每次输出约 100ms
+  m_chunk_size =
+      std::max<int64_t>(bytesPerSecond() / 10 / frame_size, 1) * frame_size;
+  if (m_decoder->planes() != 1) {
+    return;
+  }
+  m_track = PCMCache::instance().find(*m_decoder);
+  if (m_track || m_decoder->path().empty() || m_decoder->byteSource()) {
+    return;
+  }
+  // 超出内存预算的曲目不录制；缓冲在真正解码时才分配，
+  // 只预读了开头的播放列表/预加载队列不会占用整首的内存
+  if (m_decoder->duration() > 0) {
+    m_record_expected =
+        static_cast<int64_t>(m_decoder->duration() * bytesPerSecond()) +
+        bytesPerSecond();
+  }
+  if (m_record_expected > PCMCache::instance().memoryBudget()) {
+    return;
+  }
+  m_recording = true;
+}
+
+PCMCacheDecoder::~PCMCacheDecoder() { stop_recording(); }
+
+FrameDataList &PCMCacheDecoder::decodeNextFrameData() {
+  if (m_track) {
+    auto &frame_data_list = m_frame_data_list;
+    frame_data_list.clear();
+    auto len = std::min(m_chunk_size, m_track->size() - m_pos);
+    if (len > 0) {
+      // 直接指向缓存，DecodeQueue 只读取，freeData 无需释放
+      FrameData data;
+      data.data = const_cast<uint8_t *>(m_track->data() + m_pos);
+      data.size = static_cast<int>(len);
+      frame_data_list.push_back(data);
+      m_pos += len;
+    }
+    return frame_data_list;
+  }
+  auto &frame_data_list = m_decoder->decodeNextFrameData();
+  if (m_recording) {
+    record(frame_data_list);
+  }
+  return frame_data_list;
+}
+
+void PCMCacheDecoder::record(const FrameDataList &frame_data_list) {
+  for (const auto &data : frame_data_list) {
+    if (!data.data || data.size <= 0) {
+      continue;
+    }
+    auto needed = int64_t(m_record_buffer.size()) + data.size;
+    if (needed > int64_t(m_record_buffer.capacity()) &&
+        !grow_recording(needed)) {
+      stop_recording();
+      return;
+    }
+    m_record_buffer.insert(m_record_buffer.end(), data.data,
+                           data.data + data.size);
+  }
+  if (m_decoder->isEnd()) {
+    if (!m_decoder->reachedTrackEnd()) {
+      // 读错误或提前终止，录到的数据不完整
+      stop_recording();
+      return;
+    }
+    m_recording = false;
+    // 录制完成，改为按曲目大小计入缓存
+    PCMCache::instance().releaseRecording(m_record_reserved);
+    m_record_reserved = 0;
+    m_track = PCMCache::instance().insert(
+        m_decoder->path(), m_decoder->targetSampleRate(),
+        m_decoder->targetChannels(), m_decoder->targetSampleFormat(),
+        std::move(m_record_buffer));
+    // 之后 seek 直接从缓存输出，位置在结尾
+    if (m_track) {
+      m_pos = m_track->size();
+    }
+  }
+}
+
+bool PCMCacheDecoder::isEnd() const {
+  if (m_track) {
+    return m_pos >= m_track->size();
+  }
+  return m_decoder->isEnd();
+}
+
+void PCMCacheDecoder::freeData(FrameData &data) {
+  if (m_track && !data.buf && data.data >= m_track->data() &&
+      data.data < m_track->data() + m_track->size()) {
+    data.data = nullptr;
+    data.size = 0;
+    return;
+  }
+  m_decoder->freeData(data);
+}
+
+int64_t PCMCacheDecoder::bytesPerSecond() const {
+  return m_decoder->bytesPerSecond();
+}
+
+// 缓存中按采样精确定位；未命中时 seek 到开头会重新录制，其他位置放弃录制
+void PCMCacheDecoder::seek(int64_t time_ms) {
+  if (m_track) {
+    seekFrame(std::max<int64_t>(time_ms, 0) * m_track->sampleRate() / 1000);
+    return;
+  }
+  m_decoder->seek(time_ms);
+  seek_recording(time_ms <= 0);
+}
+
+void PCMCacheDecoder::seekFrame(int64_t frame) {
+  frame = std::max<int64_t>(frame, 0);
+  if (m_track) {
+    m_pos = std::min(frame * m_track->frameSize(), m_track->size());
+    return;
+  }
+  m_decoder->seekFrame(frame);
+  seek_recording(frame == 0);
+}
+
+// 按倍数扩容到估计的整首大小为止，扩容次数有限；时长未知时只按倍数扩容
+bool PCMCacheDecoder::grow_recording(int64_t needed) {
+  int64_t capacity = std::max<int64_t>(m_record_buffer.capacity() * 2,
+                                       bytesPerSecond() * 10);
+  if (m_record_expected >= needed) {
+    capacity = std::min(capacity, m_record_expected);
+  }
+  capacity = std::max(capacity, needed);
+  if (!PCMCache::instance().reserveRecording(capacity - m_record_reserved)) {
+    return false;
+  }
+  m_record_reserved = capacity;
+  m_record_buffer.reserve(capacity);
+  return true;
+}
+
+void PCMCacheDecoder::stop_recording() {
+  m_recording = false;
+  std::vector<uint8_t>().swap(m_record_buffer);
+  if (m_record_reserved > 0) {
+    PCMCache::instance().releaseRecording(m_record_reserved);
+    m_record_reserved = 0;
+  }
+}
+
+void PCMCacheDecoder::seek_recording(bool to_start) {
+  if (!m_recording) {
+    return;
+  }
+  if (to_start) {
+    m_record_buffer.clear();
+  } else {
+    stop_recording();
+  }
+}
+
+bool PCMCacheDecoder::cached() const { return m_track != nullptr; }
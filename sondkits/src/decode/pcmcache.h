@@ -0,0 +1,169 @@
+#pragma once
+
+#include "decoder.h"
+#include "mappedfile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+class AudioDecoder;
+
+// 一首曲目按某个目标格式完整解码后的交错 PCM，只读
+// 数据在内存中，或映射自磁盘缓存文件
+class PCMTrack {
+public:
+  PCMTrack(int sample_rate, int channels, AVSampleFormat format,
+           std::vector<uint8_t> pcm);
+  PCMTrack(int sample_rate, int channels, AVSampleFormat format,
+           std::unique_ptr<MappedFile> file, int64_t offset, int64_t size);
+  PCMTrack(const PCMTrack &) = delete;
+  PCMTrack &operator=(const PCMTrack &) = delete;
+
+  const uint8_t *data() const;
+  int64_t size() const;
+  int sampleRate() const;
+  int channels() const;
+  AVSampleFormat format() const;
+  int frameSize() const;
+  int64_t bytesPerSecond() const;
+  // 是否映射自磁盘缓存文件
+  bool mapped() const;
+
+private:
+  const int m_sample_rate;
+  const int m_channels;
+  const AVSampleFormat m_format;
+  std::vector<uint8_t> m_pcm;
+  std::unique_ptr<MappedFile> m_file;
+  const uint8_t *m_data;
+  int64_t m_size;
+};
+
+// 进程内共享的解码 PCM 缓存，键为 路径 + 目标采样率/声道/格式，
+// 通过文件大小和修改时间校验是否过期
+// 内存层按 LRU 淘汰，总量不超过预算；设置了缓存目录时同时写入磁盘层，
+// 内存层未命中时从磁盘映射回来，不需要重新解码
+// 被淘汰的曲目只是不再被缓存持有，正在使用它的播放/分析不受影响
+// 磁盘层在后台线程写入，不阻塞调用 insert 的解码线程
+class PCMCache {
+public:
+  explicit PCMCache(int64_t memory_budget = 512 * 1024 * 1024);
+  ~PCMCache();
+  static PCMCache &instance();
+
+  std::shared_ptr<const PCMTrack> find(const std::filesystem::path &media_path,
+                                       int sample_rate, int channels,
+                                       AVSampleFormat format);
+  // 按解码器的路径和目标格式查找，字节流输入没有文件标识，总是未命中
+  std::shared_ptr<const PCMTrack> find(const AudioDecoder &decoder);
+  std::shared_ptr<const PCMTrack>
+  insert(const std::filesystem::path &media_path, int sample_rate,
+         int channels, AVSampleFormat format, std::vector<uint8_t> pcm);
+  void remove(const std::filesystem::path &media_path);
+  void clear();
+
+  // 正在录制、尚未写入缓存的 PCM 也占用内存预算：
+  // 预留成功时按需淘汰已缓存的曲目，录制之间超出预算时返回 false
+  bool reserveRecording(int64_t bytes);
+  void releaseRecording(int64_t bytes);
+
+  void setMemoryBudget(int64_t bytes);
+  int64_t memoryBudget() const;
+  int64_t memoryUsage() const;
+  // 空路径关闭磁盘层
+  void setDiskCacheDir(const std::filesystem::path &dir);
+  std::filesystem::path diskCacheDir() const;
+
+private:
+  struct Item {
+    std::string key;
+    std::string path;
+    int64_t file_size;
+    int64_t mtime;
+    std::shared_ptr<const PCMTrack> track;
+  };
+  using ItemList = std::list<Item>;
+
+  static std::string make_key(const std::filesystem::path &media_path,
+                              int sample_rate, int channels,
+                              AVSampleFormat format);
+  static std::filesystem::path disk_path(const std::filesystem::path &dir,
+                                         const std::string &key);
+  static std::shared_ptr<const PCMTrack>
+  load_disk(const std::filesystem::path &dir, const Item &item,
+            int sample_rate, int channels, AVSampleFormat format);
+  static bool save_disk(const std::filesystem::path &dir, const Item &item);
+  void schedule_save(const std::filesystem::path &dir, const Item &item);
+  void save_loop();
+  void put(Item item);
+  void evict();
+
+private:
+  mutable std::mutex m_mutex;
+  int64_t m_memory_budget;
+  int64_t m_memory_usage;
+  int64_t m_recording_usage;
+  std::filesystem::path m_disk_dir;
+  // 待写入磁盘层的曲目
+  std::deque<std::pair<std::filesystem::path, Item>> m_save_queue;
+  std::condition_variable m_save_cv;
+  std::thread m_save_thread;
+  bool m_stop;
+  // 头部为最近使用
+  ItemList m_items;
+  std::unordered_map<std::string, ItemList::iterator> m_index;
+};
+
+// 带缓存的解码器：缓存命中时直接从 PCM 缓存输出，seek 精确到采样；
+// 未命中时转发给 AudioDecoder，并在从头顺序解码到结尾后写入缓存
+// 只支持交错格式，需要在 decoder open 之后构造
+class PCMCacheDecoder : public DecoderInterface {
+public:
+  explicit PCMCacheDecoder(std::shared_ptr<AudioDecoder> decoder);
+  ~PCMCacheDecoder() override;
+
+  FrameDataList &decodeNextFrameData() override;
+  bool isEnd() const override;
+  void freeData(FrameData &data) override;
+  int64_t bytesPerSecond() const override;
+  void seek(int64_t time_ms) override;
+  void seekFrame(int64_t frame) override;
+
+  bool cached() const;
+
+private:
+  void record(const FrameDataList &frame_data_list);
+  // 录制缓冲按需扩容，扩容部分先向缓存预留，预算不足时返回 false
+  bool grow_recording(int64_t needed);
+  void stop_recording();
+  // 未命中时 seek 之后：回到开头可以继续记录，否则放弃
+  void seek_recording(bool to_start);
+
+private:
+  std::shared_ptr<AudioDecoder> m_decoder;
+  std::shared_ptr<const PCMTrack> m_track;
+  int64_t m_pos;
+  int64_t m_chunk_size;
+  // 命中缓存时输出的列表
+  FrameDataList m_frame_data_list;
+
+  // 未命中时记录解码输出，seek 到其他位置后放弃
+  bool m_recording;
+  std::vector<uint8_t> m_record_buffer;
+  // 按时长估计的整首大小，时长未知时为 0
+  int64_t m_record_expected;
+  // 已向缓存预留的字节数
+  int64_t m_record_reserved;
+};
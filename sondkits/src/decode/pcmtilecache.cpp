@@ -0,0 +1,289 @@
+#include "pcmtilecache.h"
+#include "audiodecoder.h"
+#include "threadschedule.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+PCMTileCache::PCMTileCache(const std::filesystem::path &media_path,
+                           int sample_rate, int channels, AVSampleFormat format,
+                           PCMTileOptions options)
+    : m_path(media_path), m_sample_rate(sample_rate), m_channels(channels),
+      m_format(format), m_memory_usage(0), m_stop(false) {
+  init(options);
+}
+
+PCMTileCache::PCMTileCache(std::shared_ptr<ByteSource> source,
+                           int sample_rate, int channels, AVSampleFormat format,
+                           PCMTileOptions options)
+    : m_source(source), m_sample_rate(sample_rate), m_channels(channels),
+      m_format(format), m_memory_usage(0), m_stop(false) {
+  init(options);
+}
+
+PCMTileCache::~PCMTileCache() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_cv.notify_all();
+  }
+  if (m_prefetch_thread.joinable()) {
+    m_prefetch_thread.join();
+  }
+}
+
+void PCMTileCache::init(PCMTileOptions options) {
+  if (av_sample_fmt_is_planar(m_format)) {
+    throw std::runtime_error("PCMTileCache: planar format is not supported");
+  }
+  m_frame_size = m_channels * av_get_bytes_per_sample(m_format);
+  m_tile_seconds = std::max(options.tile_seconds, 1);
+  m_tile_frames = int64_t(m_sample_rate) * m_tile_seconds;
+  m_prefetch_tiles = std::max(options.prefetch_tiles, 0);
+  // 至少容纳一次读取涉及的块和预解码的块，避免刚解码就被淘汰
+  auto tile_size = m_tile_frames * m_frame_size;
+  m_max_tiles = std::max<int64_t>(options.memory_budget / tile_size,
+                                  m_prefetch_tiles + 3);
+
+  m_reader.decoder = new_decoder();
+  if (!m_reader.decoder->seekable()) {
+    throw std::runtime_error("PCMTileCache: input is not seekable");
+  }
+  m_total_frames =
+      (int64_t)(m_reader.decoder->duration() * m_sample_rate + 0.5);
+  m_reader.next_frame = 0;
+  if (m_prefetch_tiles > 0) {
+    m_prefetcher.decoder = new_decoder();
+    m_prefetch_thread = std::thread(&PCMTileCache::prefetch_loop, this);
+  }
+}
+
+std::shared_ptr<AudioDecoder> PCMTileCache::new_decoder() const {
+  auto decoder =
+      std::make_shared<AudioDecoder>(m_sample_rate, m_channels, m_format);
+  decoder->setFastOpen(true);
+  if (m_source) {
+    decoder->open(m_source);
+  } else {
+    decoder->open(m_path);
+  }
+  return decoder;
+}
+
+int64_t PCMTileCache::read(int64_t frame_offset, int64_t frames,
+                           uint8_t *out) {
+  if (!out || frame_offset < 0 || frames <= 0) {
+    return 0;
+  }
+  int64_t readed = 0;
+  int64_t first = frame_offset / m_tile_frames;
+  int64_t last = first;
+  while (readed < frames) {
+    auto pos = frame_offset + readed;
+    last = pos / m_tile_frames;
+    auto tile = get_tile(last);
+    auto offset = (pos - last * m_tile_frames) * m_frame_size;
+    if (!tile || offset >= (int64_t)tile->size()) {
+      break;
+    }
+    auto len = std::min<int64_t>(tile->size() - offset,
+                                 (frames - readed) * m_frame_size);
+    memcpy(out + readed * m_frame_size, tile->data() + offset, len);
+    readed += len / m_frame_size;
+    // 末尾的块不满，后面没有数据
+    if ((int64_t)tile->size() < m_tile_frames * m_frame_size &&
+        offset + len >= (int64_t)tile->size()) {
+      break;
+    }
+  }
+  // 拖动和缩放通常在附近继续读取
+  if (m_prefetch_tiles > 0) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = 1; i <= m_prefetch_tiles; i++) {
+      schedule_locked(last + i);
+    }
+    schedule_locked(first - 1);
+  }
+  return readed;
+}
+
+void PCMTileCache::prefetch(int64_t frame_offset, int64_t frames) {
+  if (m_prefetch_tiles <= 0 || frame_offset < 0 || frames <= 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto first = frame_offset / m_tile_frames;
+  auto last = (frame_offset + frames - 1) / m_tile_frames;
+  for (auto index = first; index <= last; index++) {
+    schedule_locked(index);
+  }
+}
+
+// 缓存命中时只在锁内更新 LRU；其他线程正在解码时等待它完成
+std::shared_ptr<const PCMTileCache::Tile>
+PCMTileCache::get_tile(int64_t index) {
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      if (auto tile = find_locked(index)) {
+        return tile;
+      }
+      if (!m_loading.count(index)) {
+        break;
+      }
+      m_cv.wait(lock);
+    }
+    m_loading.insert(index);
+  }
+  std::shared_ptr<const Tile> tile;
+  try {
+    std::lock_guard<std::mutex> reader_lock(m_reader_mutex);
+    try {
+      tile = decode_tile(m_reader, index);
+    } catch (...) {
+      // 解码器状态不可信，下次从 seek 开始
+      m_reader.next_frame = -1;
+      throw;
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loading.erase(index);
+    m_cv.notify_all();
+    throw;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_loading.erase(index);
+  insert_locked(index, tile);
+  m_cv.notify_all();
+  return tile;
+}
+
+// 解码器正好停在块开头时接着解码，否则按块的起始时间 seek
+std::shared_ptr<const PCMTileCache::Tile>
+PCMTileCache::decode_tile(Cursor &cursor, int64_t index) {
+  auto tile_start = index * m_tile_frames;
+  if (cursor.next_frame != tile_start) {
+    cursor.decoder->seek(index * m_tile_seconds * 1000);
+    cursor.next_frame = tile_start;
+    cursor.carry.clear();
+  }
+  auto tile_size = m_tile_frames * m_frame_size;
+  auto tile = std::make_shared<Tile>();
+  tile->reserve(tile_size);
+
+  auto append = [&](const uint8_t *data, int64_t size) {
+    auto len = std::min<int64_t>(size, tile_size - tile->size());
+    tile->insert(tile->end(), data, data + len);
+    cursor.carry.insert(cursor.carry.end(), data + len, data + size);
+  };
+  std::vector<uint8_t> carry;
+  carry.swap(cursor.carry);
+  append(carry.data(), carry.size());
+  while ((int64_t)tile->size() < tile_size && !cursor.decoder->isEnd()) {
+    auto &frames = cursor.decoder->decodeNextFrameData();
+    for (auto &frame : frames) {
+      if (frame.data) {
+        append(frame.data, frame.size);
+      }
+      cursor.decoder->freeData(frame);
+    }
+  }
+  cursor.next_frame = tile_start + tile->size() / m_frame_size;
+  return tile;
+}
+
+std::shared_ptr<const PCMTileCache::Tile>
+PCMTileCache::find_locked(int64_t index) {
+  auto it = m_index.find(index);
+  if (it == m_index.end()) {
+    return nullptr;
+  }
+  m_items.splice(m_items.begin(), m_items, it->second);
+  return it->second->tile;
+}
+
+void PCMTileCache::insert_locked(int64_t index,
+                                 std::shared_ptr<const Tile> tile) {
+  if (m_index.count(index)) {
+    return;
+  }
+  m_items.push_front({index, tile});
+  m_index[index] = m_items.begin();
+  m_memory_usage += tile->size();
+  while (m_items.size() > m_max_tiles) {
+    auto &item = m_items.back();
+    m_memory_usage -= item.tile->size();
+    m_index.erase(item.index);
+    m_items.pop_back();
+  }
+}
+
+void PCMTileCache::schedule_locked(int64_t index) {
+  if (index < 0 ||
+      (m_total_frames > 0 && index * m_tile_frames >= m_total_frames)) {
+    return;
+  }
+  if (m_index.count(index) || m_loading.count(index) ||
+      std::find(m_prefetch_queue.begin(), m_prefetch_queue.end(), index) !=
+          m_prefetch_queue.end()) {
+    return;
+  }
+  m_prefetch_queue.push_back(index);
+  // 跟不上时丢弃最早的请求，只预解码最近读取位置附近的块
+  while (m_prefetch_queue.size() > (size_t)m_prefetch_tiles + 1) {
+    m_prefetch_queue.pop_front();
+  }
+  m_cv.notify_all();
+}
+
+void PCMTileCache::prefetch_loop() {
+  promoteCurrentThread(ThreadRole::Worker);
+  while (true) {
+    int64_t index = -1;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock,
+                [this]() { return m_stop || !m_prefetch_queue.empty(); });
+      if (m_stop) {
+        break;
+      }
+      index = m_prefetch_queue.front();
+      m_prefetch_queue.pop_front();
+      if (m_index.count(index) || m_loading.count(index)) {
+        continue;
+      }
+      m_loading.insert(index);
+    }
+    std::shared_ptr<const Tile> tile;
+    try {
+      tile = decode_tile(m_prefetcher, index);
+    } catch (const std::exception &e) {
+      std::cerr << "Error prefetching tile " << index << ": " << e.what()
+                << std::endl;
+      // 解码器状态不可信，下次从 seek 开始
+      m_prefetcher.next_frame = -1;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_loading.erase(index);
+    if (tile) {
+      insert_locked(index, tile);
+    }
+    m_cv.notify_all();
+  }
+}
+
+int64_t PCMTileCache::totalFrames() const { return m_total_frames; }
+
+int PCMTileCache::sampleRate() const { return m_sample_rate; }
+
+int PCMTileCache::channels() const { return m_channels; }
+
+AVSampleFormat PCMTileCache::format() const { return m_format; }
+
+int PCMTileCache::frameSize() const { return m_frame_size; }
+
+int64_t PCMTileCache::memoryUsage() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_memory_usage;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "bytesource.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+extern "C" {
+#include <libavutil/samplefmt.h>
+}
+
+class AudioDecoder;
+
+struct PCMTileOptions {
+  // 每块的时长，整秒保证块边界与 seek 的毫秒时间精确对应
+  int tile_seconds = 1;
+  // 内存中最多保留的解码数据，按 LRU 淘汰
+  int64_t memory_budget = 64 * 1024 * 1024;
+  // 每次读取后后台预解码的后续块数，前一块总是预解码
+  int prefetch_tiles = 2;
+};
+
+// 压缩音频上的随机访问 PCM：按固定时长的块解码并缓存，
+// 波形缩放、拖动试听、循环编辑等按任意采样位置读取时，
+// 同一区域重复读取只是内存拷贝；块内连续读取不 seek，
+// 跳读时的 seek 使用解码器的包索引(分析时建立)
+// 读取线程和后台预解码线程各用一个解码器，同一块不会重复解码
+// 只支持交错格式和可 seek 的输入
+class PCMTileCache {
+public:
+  PCMTileCache(const std::filesystem::path &media_path, int sample_rate,
+               int channels, AVSampleFormat format,
+               PCMTileOptions options = PCMTileOptions());
+  PCMTileCache(std::shared_ptr<ByteSource> source, int sample_rate,
+               int channels, AVSampleFormat format,
+               PCMTileOptions options = PCMTileOptions());
+  ~PCMTileCache();
+  PCMTileCache(const PCMTileCache &) = delete;
+  PCMTileCache &operator=(const PCMTileCache &) = delete;
+
+  // 从 frame_offset 帧起读取最多 frames 帧到 out，返回读到的帧数，
+  // 到达末尾时少于 frames；缺少的块在调用线程上解码
+  int64_t read(int64_t frame_offset, int64_t frames, uint8_t *out);
+  // 提示后台线程预解码这一段
+  void prefetch(int64_t frame_offset, int64_t frames);
+  // 时长未知时为 0
+  int64_t totalFrames() const;
+  int sampleRate() const;
+  int channels() const;
+  AVSampleFormat format() const;
+  int frameSize() const;
+  int64_t memoryUsage() const;
+
+private:
+  using Tile = std::vector<uint8_t>;
+  // 一个解码器及其当前解码位置，紧接着的块不需要 seek
+  struct Cursor {
+    std::shared_ptr<AudioDecoder> decoder;
+    int64_t next_frame = -1;
+    // 上一块装满后多解码出的数据，属于下一块
+    std::vector<uint8_t> carry;
+  };
+  struct Item {
+    int64_t index;
+    std::shared_ptr<const Tile> tile;
+  };
+  using ItemList = std::list<Item>;
+
+  void init(PCMTileOptions options);
+  std::shared_ptr<AudioDecoder> new_decoder() const;
+  std::shared_ptr<const Tile> get_tile(int64_t index);
+  std::shared_ptr<const Tile> decode_tile(Cursor &cursor, int64_t index);
+  // 以下在持有 m_mutex 时调用
+  std::shared_ptr<const Tile> find_locked(int64_t index);
+  void insert_locked(int64_t index, std::shared_ptr<const Tile> tile);
+  void schedule_locked(int64_t index);
+  void prefetch_loop();
+
+private:
+  const std::filesystem::path m_path;
+  const std::shared_ptr<ByteSource> m_source;
+  const int m_sample_rate;
+  const int m_channels;
+  const AVSampleFormat m_format;
+  int m_frame_size;
+  int m_tile_seconds;
+  int64_t m_tile_frames;
+  int64_t m_total_frames;
+  int m_prefetch_tiles;
+  size_t m_max_tiles;
+
+  // 读取线程的解码器，多个线程同时读取时串行解码
+  std::mutex m_reader_mutex;
+  Cursor m_reader;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  // 头部为最近使用
+  ItemList m_items;
+  std::unordered_map<int64_t, ItemList::iterator> m_index;
+  // 正在解码的块，其他线程等待而不是重复解码
+  std::unordered_set<int64_t> m_loading;
+  std::deque<int64_t> m_prefetch_queue;
+  int64_t m_memory_usage;
+
+  // prefetch
+  Cursor m_prefetcher;
+  std::thread m_prefetch_thread;
+  bool m_stop;
+};
@@ -0,0 +1,122 @@
+#include "probecache.h"
+#include "common.h"
+
+static std::shared_ptr<const AVCodecParameters>
+copyCodecParameters(const AVCodecParameters *par) {
+  AVCodecParameters *copy = avcodec_parameters_alloc();
+  if (!copy) {
+    return nullptr;
+  }
+  if (avcodec_parameters_copy(copy, par) < 0) {
+    avcodec_parameters_free(&copy);
+    return nullptr;
+  }
+  return std::shared_ptr<const AVCodecParameters>(
+      copy, [](const AVCodecParameters *p) {
+        auto par = const_cast<AVCodecParameters *>(p);
+        avcodec_parameters_free(&par);
+      });
+}
+
+ProbeCache::ProbeCache(size_t capacity)
+    : m_capacity(std::max<size_t>(capacity, 1)) {}
+
+ProbeCache &ProbeCache::instance() {
+  static ProbeCache cache;
+  return cache;
+}
+
+bool ProbeCache::find(const std::filesystem::path &media_path, Entry *entry,
+                      bool full_probe) {
+  int64_t file_size = 0, mtime = 0;
+  if (!entry || !mediaFileKey(media_path, &file_size, &mtime)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_index.find(media_path.u8string());
+  if (it == m_index.end()) {
+    return false;
+  }
+  auto item = it->second;
+  if (item->file_size != file_size || item->mtime != mtime) {
+    // 文件已被修改
+    m_items.erase(item);
+    m_index.erase(it);
+    return false;
+  }
+  if (full_probe && !item->entry.full_probe) {
+    return false;
+  }
+  m_items.splice(m_items.begin(), m_items, item);
+  *entry = item->entry;
+  return true;
+}
+
+void ProbeCache::insert(const std::filesystem::path &media_path,
+                        const AVFormatContext *fmt_ctx, int stream_index,
+                        bool full_probe) {
+  if (!fmt_ctx || stream_index < 0 ||
+      stream_index >= (int)fmt_ctx->nb_streams) {
+    return;
+  }
+  int64_t file_size = 0, mtime = 0;
+  if (!mediaFileKey(media_path, &file_size, &mtime)) {
+    return;
+  }
+  const AVStream *stream = fmt_ctx->streams[stream_index];
+  Item item;
+  item.path = media_path.u8string();
+  item.file_size = file_size;
+  item.mtime = mtime;
+  item.entry.iformat = fmt_ctx->iformat;
+  item.entry.stream_index = stream_index;
+  item.entry.time_base = stream->time_base;
+  item.entry.start_time = stream->start_time;
+  item.entry.stream_duration = stream->duration;
+  item.entry.duration = fmt_ctx->duration;
+  item.entry.bit_rate = fmt_ctx->bit_rate;
+  item.entry.codecpar = copyCodecParameters(stream->codecpar);
+  item.entry.full_probe = full_probe;
+  if (!item.entry.codecpar) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_index.find(item.path);
+  if (it != m_index.end()) {
+    const auto &old = *it->second;
+    if (!full_probe && old.entry.full_probe && old.file_size == file_size &&
+        old.mtime == mtime) {
+      return;
+    }
+    m_items.erase(it->second);
+    m_index.erase(it);
+  }
+  m_items.push_front(std::move(item));
+  m_index[m_items.front().path] = m_items.begin();
+  while (m_items.size() > m_capacity) {
+    m_index.erase(m_items.back().path);
+    m_items.pop_back();
+  }
+}
+
+void ProbeCache::remove(const std::filesystem::path &media_path) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_index.find(media_path.u8string());
+  if (it == m_index.end()) {
+    return;
+  }
+  m_items.erase(it->second);
+  m_index.erase(it);
+}
+
+void ProbeCache::clear() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_items.clear();
+  m_index.clear();
+}
+
+size_t ProbeCache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_items.size();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+// 进程内的流探测结果缓存，键为 路径 + 文件大小 + 修改时间
+// 同一文件再次打开(分析、预加载、分段解码)时跳过格式探测和
+// avformat_find_stream_info，按 LRU 淘汰
+// 快速打开限制了探测量，时长和参数可能是估算值，只提供给快速打开；
+// 完整探测的结果两种打开方式都可以使用
+class ProbeCache {
+public:
+  struct Entry {
+    const AVInputFormat *iformat = nullptr;
+    int stream_index = -1;
+    AVRational time_base = {0, 1};
+    int64_t start_time = AV_NOPTS_VALUE;
+    int64_t stream_duration = AV_NOPTS_VALUE;
+    // AVFormatContext 级的时长和码率
+    int64_t duration = AV_NOPTS_VALUE;
+    int64_t bit_rate = 0;
+    std::shared_ptr<const AVCodecParameters> codecpar;
+    // 是否为不限探测量的完整探测结果
+    bool full_probe = false;
+  };
+
+  explicit ProbeCache(size_t capacity = 4096);
+  static ProbeCache &instance();
+
+  // full_probe 为 true 时只返回完整探测的结果
+  bool find(const std::filesystem::path &media_path, Entry *entry,
+            bool full_probe);
+  // 从已探测完成的 fmt_ctx 中记录 stream_index 对应的参数；
+  // 快速探测的结果不会覆盖已有的完整探测结果
+  void insert(const std::filesystem::path &media_path,
+              const AVFormatContext *fmt_ctx, int stream_index,
+              bool full_probe);
+  void remove(const std::filesystem::path &media_path);
+  void clear();
+  size_t size() const;
+
+private:
+  struct Item {
+    std::string path;
+    int64_t file_size;
+    int64_t mtime;
+    Entry entry;
+  };
+  using ItemList = std::list<Item>;
+
+  const size_t m_capacity;
+  mutable std::mutex m_mutex;
+  // 头部为最近使用
+  ItemList m_items;
+  std::unordered_map<std::string, ItemList::iterator> m_index;
+};
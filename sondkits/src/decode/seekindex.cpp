@@ -0,0 +1,169 @@
+#include "seekindex.h"
+#include "common.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const char kSeekIndexMagic[4] = {'S', 'K', 'I', 'X'};
+static const uint32_t kSeekIndexVersion = 1;
+
+// 条目按差值存储为 LEB128 变长整数
+static void writeVarint(std::ostream &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.put(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.put(static_cast<char>(v));
+}
+
+static bool readVarint(std::istream &in, uint64_t *v) {
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = in.get();
+    if (c == EOF) {
+      return false;
+    }
+    result |= static_cast<uint64_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      *v = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T> static void writePod(std::ostream &out, T v) {
+  out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T> static bool readPod(std::istream &in, T *v) {
+  return static_cast<bool>(in.read(reinterpret_cast<char *>(v), sizeof(T)));
+}
+
+SeekIndex::SeekIndex() {}
+
+void SeekIndex::clear() { m_entries.clear(); }
+
+bool SeekIndex::empty() const { return m_entries.empty(); }
+
+size_t SeekIndex::size() const { return m_entries.size(); }
+
+void SeekIndex::add(int64_t pts, int64_t pos, int64_t min_interval) {
+  if (pos < 0) {
+    return;
+  }
+  if (!m_entries.empty()) {
+    const auto &last = m_entries.back();
+    if (pts < last.pts + min_interval || pos <= last.pos) {
+      return;
+    }
+  }
+  m_entries.push_back(Entry{pts, pos});
+}
+
+const SeekIndex::Entry *SeekIndex::find(int64_t target_pts) const {
+  auto it = std::upper_bound(
+      m_entries.begin(), m_entries.end(), target_pts,
+      [](int64_t pts, const Entry &entry) { return pts < entry.pts; });
+  if (it == m_entries.begin()) {
+    return nullptr;
+  }
+  return &*(it - 1);
+}
+
+std::filesystem::path
+SeekIndex::sidecarPath(const std::filesystem::path &media_path) {
+  auto path = media_path;
+  path += ".seekidx";
+  return path;
+}
+
+bool SeekIndex::load(const std::filesystem::path &media_path) {
+  m_entries.clear();
+  int64_t file_size = 0, mtime = 0;
+  if (!mediaFileKey(media_path, &file_size, &mtime)) {
+    return false;
+  }
+  std::ifstream in(sidecarPath(media_path), std::ios::binary | std::ios::ate);
+  if (!in.is_open()) {
+    return false;
+  }
+  int64_t index_size = in.tellg();
+  in.seekg(0);
+  char magic[4];
+  uint32_t version = 0;
+  int64_t index_file_size = 0, index_mtime = 0;
+  uint64_t count = 0;
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, kSeekIndexMagic, sizeof(magic)) != 0 ||
+      !readPod(in, &version) || version != kSeekIndexVersion ||
+      !readPod(in, &index_file_size) || !readPod(in, &index_mtime) ||
+      !readPod(in, &count)) {
+    return false;
+  }
+  if (index_file_size != file_size || index_mtime != mtime) {
+    // 媒体文件已变化，索引失效
+    return false;
+  }
+  // 每条记录至少两个字节，条目数不可信时不按它分配内存
+  int64_t remaining = index_size - int64_t(in.tellg());
+  if (remaining < 0 || count > uint64_t(remaining) / 2) {
+    return false;
+  }
+  std::vector<Entry> entries;
+  try {
+    entries.reserve(count);
+    int64_t pts = 0, pos = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      uint64_t pts_delta = 0, pos_delta = 0;
+      if (!readVarint(in, &pts_delta) || !readVarint(in, &pos_delta)) {
+        return false;
+      }
+      // 首条记录相对 0 存储，pts 为负时按补码回绕
+      pts += static_cast<int64_t>(pts_delta);
+      pos += static_cast<int64_t>(pos_delta);
+      entries.push_back(Entry{pts, pos});
+    }
+  } catch (const std::exception &) {
+    // 索引只是加速手段，损坏时按没有索引处理，不向 open 抛出
+    return false;
+  }
+  m_entries = std::move(entries);
+  return true;
+}
+
+bool SeekIndex::save(const std::filesystem::path &media_path) const {
+  int64_t file_size = 0, mtime = 0;
+  if (m_entries.empty() || !mediaFileKey(media_path, &file_size, &mtime)) {
+    return false;
+  }
+  auto path = sidecarPath(media_path);
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+  out.write(kSeekIndexMagic, sizeof(kSeekIndexMagic));
+  writePod(out, kSeekIndexVersion);
+  writePod(out, file_size);
+  writePod(out, mtime);
+  writePod(out, static_cast<uint64_t>(m_entries.size()));
+  int64_t last_pts = 0, last_pos = 0;
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    const auto &entry = m_entries[i];
+    writeVarint(out, static_cast<uint64_t>(entry.pts - last_pts));
+    writeVarint(out, static_cast<uint64_t>(entry.pos - last_pos));
+    last_pts = entry.pts;
+    last_pos = entry.pos;
+  }
+  out.close();
+  std::error_code ec;
+  if (!out) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  // 先写临时文件再改名，其他实例不会读到写了一半的索引
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 包级 seek 索引：pts(流 time_base) -> 字节偏移
+// 在完整顺序解码时建立，以旁路文件(媒体路径 + ".seekidx")持久化，
+// 通过文件大小和修改时间校验是否过期
+class SeekIndex {
+public:
+  struct Entry {
+    int64_t pts;
+    int64_t pos;
+  };
+
+  SeekIndex();
+
+  void clear();
+  bool empty() const;
+  size_t size() const;
+  // pts 单调递增时追加，两条记录至少相隔 min_interval
+  void add(int64_t pts, int64_t pos, int64_t min_interval);
+  // 二分查找 pts <= target 的最后一条记录，没有则返回 nullptr
+  const Entry *find(int64_t target_pts) const;
+
+  bool load(const std::filesystem::path &media_path);
+  bool save(const std::filesystem::path &media_path) const;
+  static std::filesystem::path
+  sidecarPath(const std::filesystem::path &media_path);
+
+private:
+  std::vector<Entry> m_entries;
+};